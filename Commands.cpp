@@ -10,6 +10,24 @@
 #include "Commands.h"
 #include <fcntl.h>
 #include <unordered_set>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <signal.h>
+#include <algorithm>
+#include <cstddef>
+#include <sys/sendfile.h>
+#include <sys/mman.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <spawn.h>
+#include <glob.h>
+#include <langinfo.h>
+#include <locale.h>
+#include "signals.h"
+#include "Stats.h"
+#include "TextScan.h"
 
 #include <net/if.h>
 #include <cerrno>
@@ -38,8 +56,8 @@ const std::string WHITESPACE = " \n\r\t\f\v";
 #pragma region OWN HELPERS
 
 void printError(std::string sysCallName) {
-    std::string errorText = "smash error: " + sysCallName + " failed";
-    perror(errorText.c_str());
+    int savedErrno = errno;
+    smashErr() << "smash error: " << sysCallName << " failed: " << strerror(savedErrno) << std::endl;
 }
 
 std::string readFile(const std::string path) {
@@ -117,7 +135,7 @@ struct linuxDirectoryEntry {
     char m_fileName[];
 };
 
-long recursiveFolderSizeCalc(const std::string &path, const bool isBasePath = false) {
+long recursiveFolderSizeCalc(const std::string &path, const bool isBasePath) {
     long totalSize = 0;
     char buffer[KB4];
 
@@ -259,9 +277,9 @@ static std::vector<std::string> getDnsServers() {
     return v;
 }
 
-static bool parseUtimeStime(const std::string &statLine,
-                            unsigned long long &utime,
-                            unsigned long long &stime) {
+bool parseUtimeStime(const std::string &statLine,
+                     unsigned long long &utime,
+                     unsigned long long &stime) {
     size_t rp = statLine.find(')');
     if (rp == std::string::npos) return false;
 
@@ -288,6 +306,35 @@ static bool parseTotalCpuTicks(const std::string &statContent,
     return true;
 }
 
+/* ---------- Pipes ---------- */
+//"65536", "64K", "1M" -> bytes
+static bool parseSize(const std::string &text, int &size) {
+    size_t idx = 0;
+    long value;
+    try {
+        value = std::stol(text, &idx);
+    } catch (...) {
+        return false;
+    }
+    std::string suffix = text.substr(idx);
+    if (suffix == "K" || suffix == "k") value <<= 10;
+    else if (suffix == "M" || suffix == "m") value <<= 20;
+    else if (!suffix.empty()) return false;
+    if (value < 0 || value > INT32_MAX) return false;
+    size = (int) value;
+    return true;
+}
+
+//what F_SETPIPE_SZ accepts from an unprivileged process, read once
+static int pipeMaxSize() {
+    static int maxSize = -1;
+    if (maxSize == -1) {
+        std::string content = readFile("/proc/sys/fs/pipe-max-size");
+        maxSize = content.empty() ? 1 << 20 : std::atoi(content.c_str());
+    }
+    return maxSize;
+}
+
 #pragma endregion
 
 //--------------------GIVEN HELPERS--------------------//
@@ -379,6 +426,468 @@ std::string removeBackgroundSign(const std::string cmd_line) {
 
 #pragma endregion
 
+//--------------------REDIRECTION HELPERS--------------------//
+#pragma region REDIRECTION HELPERS
+
+//splits "cmd args > out 2>> err < in" into the command part and its fd actions.
+//supported: <, >, >>, 2>, 2>>, &>, &>> and the copies >&M, 2>&M of fd 0, 1 or 2. returns what
+//is wrong with the line, nullptr if nothing.
+static const char *parseRedirections(const std::string &cmdLine, std::string &commandPart,
+                                     std::vector<FdAction> &actions) {
+    size_t i = 0, n = cmdLine.size();
+    while (i < n) {
+        char c = cmdLine[i];
+        bool stderrOp = c == '2' && i + 1 < n && cmdLine[i + 1] == '>' &&
+                        (i == 0 || isspace((unsigned char) cmdLine[i - 1]));
+        bool bothOp = c == '&' && i + 1 < n && cmdLine[i + 1] == '>';
+        if (c != '<' && c != '>' && !stderrOp && !bothOp) {
+            commandPart += c;
+            ++i;
+            continue;
+        }
+        FdAction action;
+        action.m_sourceFd = -1;
+        if (c == '<') {
+            action.m_targetFd = STDIN_FILENO;
+            action.m_flags = O_RDONLY;
+            ++i;
+        } else {
+            if (stderrOp || bothOp) ++i;    //now on the '>'
+            action.m_targetFd = stderrOp ? STDERR_FILENO : STDOUT_FILENO;
+            bool append = i + 1 < n && cmdLine[i + 1] == '>';
+            action.m_flags = O_WRONLY | O_CREAT | (append ? O_APPEND : O_TRUNC);
+            i += append ? 2 : 1;
+            if (i < n && cmdLine[i] == '&') {
+                //a copy of fd M, in order with the files: "> out 2>&1" sends both to out
+                char source = i + 1 < n ? cmdLine[i + 1] : '\0';
+                bool ended = i + 2 == n || isspace((unsigned char) cmdLine[i + 2]) || cmdLine[i + 2] == '<' ||
+                             cmdLine[i + 2] == '>';
+                if (append || bothOp || source < '0' || source > '2' || !ended) return "bad file descriptor";
+                FdAction dupAction = {action.m_targetFd, source - '0', 0, ""};
+                actions.push_back(dupAction);
+                commandPart += ' ';
+                i += 2;
+                continue;
+            }
+        }
+        size_t start = cmdLine.find_first_not_of(WHITESPACE, i);
+        if (start == std::string::npos) return "missing file name";
+        size_t end = cmdLine.find_first_of(WHITESPACE + "<>", start);
+        if (end == start) return "missing file name";
+        if (end == std::string::npos) end = n;
+        action.m_path = cmdLine.substr(start, end - start);
+        actions.push_back(action);
+        if (bothOp) {
+            FdAction dupAction = {STDERR_FILENO, STDOUT_FILENO, 0, ""};
+            actions.push_back(dupAction);
+        }
+        commandPart += ' ';
+        i = end;
+    }
+    commandPart = _trim(commandPart);
+    return nullptr;
+}
+
+//used in a forked child before exec - open/dup2/close only.
+static bool applyFdActions(const std::vector<FdAction> &actions) {
+    for (const FdAction &action: actions) {
+        if (action.m_path.empty()) {
+            if (dup2(action.m_sourceFd, action.m_targetFd) == -1) {
+                printError("dup2");
+                return false;
+            }
+            continue;
+        }
+        int fd = syscall(SYS_open, action.m_path.c_str(), action.m_flags, 0666);
+        if (fd == -1) {
+            printError("open");
+            return false;
+        }
+        if (fd != action.m_targetFd) {
+            if (dup2(fd, action.m_targetFd) == -1) {
+                printError("dup2");
+                close(fd);
+                return false;
+            }
+            close(fd);
+        }
+    }
+    return true;
+}
+
+//for commands that run inside smash: open the files into a copy of the current IoContext
+//instead of touching smash's own fds. opened fds are returned for closing afterwards.
+static bool openFdActions(const std::vector<FdAction> &actions, IoContext &io, std::vector<int> &opened) {
+    for (const FdAction &action: actions) {
+        int fd;
+        if (action.m_path.empty()) {
+            fd = action.m_sourceFd == STDIN_FILENO ? io.m_inFd :
+                 action.m_sourceFd == STDOUT_FILENO ? io.m_outFd : io.m_errFd;
+        } else {
+            fd = syscall(SYS_open, action.m_path.c_str(), action.m_flags | O_CLOEXEC, 0666);
+            if (fd == -1) {
+                printError("open");
+                return false;
+            }
+            opened.push_back(fd);
+        }
+        if (action.m_targetFd == STDIN_FILENO) io.m_inFd = fd;
+        else if (action.m_targetFd == STDOUT_FILENO) io.m_outFd = fd;
+        else io.m_errFd = fd;
+    }
+    return true;
+}
+
+#pragma endregion
+
+//--------------------DATA TRANSFER HELPERS--------------------//
+#pragma region DATA TRANSFER HELPERS
+
+#define TRANSFER_CHUNK (1 << 20)
+
+static bool writeAll(int fd, const char *data, long size) {
+    while (size > 0) {
+        long written = syscall(SYS_write, fd, data, size);
+        if (written == -1) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+static bool copyWithBuffer(int inFd, int outFd) {
+    std::vector<char> buffer(TRANSFER_CHUNK / 8);
+    while (true) {
+        long bytesRead = syscall(SYS_read, inFd, buffer.data(), buffer.size());
+        if (bytesRead == 0) return true;
+        if (bytesRead == -1) {
+            if (errno == EINTR) continue;
+            printError("read");
+            return false;
+        }
+        if (!writeAll(outFd, buffer.data(), bytesRead)) {
+            if (errno != EPIPE) printError("write");
+            return false;
+        }
+    }
+}
+
+//copies inFd to outFd until EOF without passing the data through userspace when possible:
+//file->file with copy_file_range, anything with a pipe end with splice, file->other with
+//sendfile. falls back to read/write if the kernel refuses before anything was moved.
+static bool transferFd(int inFd, int outFd) {
+    struct stat inStat, outStat;
+    if (fstat(inFd, &inStat) == -1 || fstat(outFd, &outStat) == -1) {
+        return copyWithBuffer(inFd, outFd);
+    }
+    bool inFile = S_ISREG(inStat.st_mode), outFile = S_ISREG(outStat.st_mode);
+    bool anyPipe = S_ISFIFO(inStat.st_mode) || S_ISFIFO(outStat.st_mode);
+    bool movedAny = false;
+    while (true) {
+        long moved;
+        if (inFile && outFile) {
+            moved = copy_file_range(inFd, nullptr, outFd, nullptr, TRANSFER_CHUNK, 0);
+        } else if (anyPipe) {
+            moved = splice(inFd, nullptr, outFd, nullptr, TRANSFER_CHUNK, SPLICE_F_MOVE);
+        } else if (inFile) {
+            moved = sendfile(outFd, inFd, nullptr, TRANSFER_CHUNK);
+        } else {
+            return copyWithBuffer(inFd, outFd);
+        }
+        if (moved == 0) return true;
+        if (moved > 0) {
+            movedAny = true;
+            continue;
+        }
+        if (errno == EINTR) continue;
+        if (errno == EPIPE) return false;
+        //EBADF: copy_file_range refuses O_APPEND outputs
+        if (!movedAny && (errno == EINVAL || errno == EXDEV || errno == ENOSYS || errno == EOPNOTSUPP ||
+                          errno == EBADF)) {
+            return copyWithBuffer(inFd, outFd);
+        }
+        printError(inFile && outFile ? "copy_file_range" : anyPipe ? "splice" : "sendfile");
+        return false;
+    }
+}
+
+//tee for the common "pipe in, pipe out, at most one file" case: tee(2) duplicates the
+//pipe data into outFd, then the same bytes are spliced from inFd into the file.
+//returns false with errno == EINVAL if the fds don't qualify, before consuming any input.
+static bool teePipe(int inFd, int outFd, int fileFd) {
+    bool movedAny = false;
+    while (true) {
+        long duplicated = tee(inFd, outFd, TRANSFER_CHUNK, 0);
+        if (duplicated == -1) {
+            if (errno == EINTR) continue;
+            if (!movedAny) return false;
+            if (errno != EPIPE) printError("tee");
+            return true;
+        }
+        if (duplicated == 0) return true;
+        movedAny = true;
+        while (duplicated > 0) {
+            long spliced = fileFd == -1 ? -1 : splice(inFd, nullptr, fileFd, nullptr, duplicated, SPLICE_F_MOVE);
+            if (spliced == -1) {
+                if (errno == EINTR) continue;
+                //no file (or it can't take a splice): just consume what was duplicated
+                char buffer[KB4];
+                long bytesRead = syscall(SYS_read, inFd, buffer, std::min<long>(duplicated, sizeof(buffer)));
+                if (bytesRead <= 0) return true;
+                if (fileFd != -1) writeAll(fileFd, buffer, bytesRead);
+                duplicated -= bytesRead;
+                continue;
+            }
+            duplicated -= spliced;
+        }
+    }
+}
+
+#pragma endregion
+
+//--------------------TEXT BUILT-IN HELPERS--------------------//
+#pragma region TEXT BUILT-IN HELPERS
+
+#define TEXT_BLOCK (1 << 17)
+
+//an input of wc/head/grep. m_name is the operand as typed, nullptr when there was none
+struct TextInput {
+    int m_fd;
+    const char *m_name;
+};
+
+static void closeTextInputs(const std::vector<TextInput> &inputs) {
+    for (const TextInput &input: inputs) {
+        if (input.m_fd != currentIo().m_inFd) close(input.m_fd);
+    }
+}
+
+//opens the operands, the IoContext's input for "-" or none at all. false, with nothing left
+//open, if one cannot be opened or is a directory: the real tool then reports it in its words.
+//from here on a ctrl-C stops the reads (readRetry), one from before this command is dropped
+static bool openTextInputs(const std::vector<const char *> &operands, std::vector<TextInput> &inputs) {
+    if (SmallShell::getInstance().isShellThread()) takeCtrlC();
+    int inFd = currentIo().m_inFd;
+    if (operands.empty()) {
+        inputs.push_back({inFd, nullptr});
+        return true;
+    }
+    for (const char *operand: operands) {
+        int fd = strcmp(operand, "-") == 0 ? inFd : (int) syscall(SYS_open, operand, O_RDONLY | O_CLOEXEC);
+        struct stat st;
+        if (fd == -1 || fstat(fd, &st) == -1 || S_ISDIR(st.st_mode)) {
+            if (fd != -1 && fd != inFd) close(fd);
+            closeTextInputs(inputs);
+            inputs.clear();
+            return false;
+        }
+        inputs.push_back({fd, operand});
+    }
+    return true;
+}
+
+//-1 on an error (printed) or, on smash's thread, a ctrl-C (errno EINTR, nothing printed).
+//SIGINT restarts read(), so the wait for data is a poll(), which it does interrupt
+static long readRetry(int fd, char *buffer, size_t size) {
+    bool shellThread = SmallShell::getInstance().isShellThread();
+    while (true) {
+        struct pollfd ready = {fd, POLLIN, 0};
+        if (shellThread && (takeCtrlC() || (poll(&ready, 1, -1) == -1 && errno == EINTR && takeCtrlC()))) {
+            errno = EINTR;
+            return -1;
+        }
+        long bytesRead = syscall(SYS_read, fd, buffer, size);
+        if (bytesRead == -1 && errno == EINTR) continue;
+        if (bytesRead == -1) printError("read");
+        return bytesRead;
+    }
+}
+
+//output of wc/head/grep, gathered into TEXT_BLOCK sized writes on the fd. after a failed write
+//(the reader of the pipe exited) everything is dropped and the built-in stops reading
+class TextSink {
+    int m_fd;
+    std::vector<char> m_buffer;
+    size_t m_used = 0;
+    bool m_failed = false;
+
+public:
+    explicit TextSink(int fd) : m_fd(fd), m_buffer(TEXT_BLOCK) {}
+
+    ~TextSink() {
+        flush();
+    }
+
+    void append(const char *data, size_t length) {
+        if (m_failed) return;
+        if (m_used + length > m_buffer.size()) {
+            flush();
+            if (length >= m_buffer.size()) {
+                m_failed = !writeAll(m_fd, data, length);
+                return;
+            }
+        }
+        memcpy(m_buffer.data() + m_used, data, length);
+        m_used += length;
+    }
+
+    void append(const std::string &text) {
+        append(text.data(), text.size());
+    }
+
+    void flush() {
+        if (m_used > 0 && !m_failed) m_failed = !writeAll(m_fd, m_buffer.data(), m_used);
+        m_used = 0;
+    }
+
+    bool failed() const {
+        return m_failed;
+    }
+};
+
+//the real tool instead of the built-in; in the background, so that it is a job like any other
+static void runTextTool(Command &cmd) {
+    std::string cmdLine = cmd.getCmdLineFull();
+    ExternalCommand(cmdLine.c_str()).execute();
+}
+
+static bool allDigits(const char *text) {
+    return *text != '\0' && strspn(text, "0123456789") == strlen(text);
+}
+
+//whether grep would decode its input as UTF-8 (0), as single bytes (1) or otherwise (-1)
+static int grepEncoding() {
+    locale_t locale = newlocale(LC_CTYPE_MASK, "", (locale_t) 0);
+    if (locale == (locale_t) 0) return 1;       //an unknown locale leaves grep in C
+    std::string codeset = nl_langinfo_l(CODESET, locale);
+    freelocale(locale);
+    if (codeset == "UTF-8") return 0;
+    return codeset == "ANSI_X3.4-1968" ? 1 : -1;
+}
+
+//UTF-8 as glibc decodes it: no overlong forms or surrogates, but up to 6 bytes (0x7fffffff)
+static bool isValidUtf8(const unsigned char *text, size_t length) {
+    static const uint32_t MINIMUM[] = {0, 0, 0x80, 0x800, 0x10000, 0x200000, 0x4000000};
+    size_t i = 0;
+    while (i < length) {
+        unsigned char lead = text[i];
+        if (lead < 0x80) {
+            i++;
+            continue;
+        }
+        int size = lead < 0xc2 ? 0 : lead < 0xe0 ? 2 : lead < 0xf0 ? 3 : lead < 0xf8 ? 4 : lead < 0xfc ? 5 :
+                                                                                       lead < 0xfe ? 6 : 0;
+        if (size == 0 || length - i < (size_t) size) return false;
+        uint32_t value = lead & (0x7f >> size);
+        for (int k = 1; k < size; k++) {
+            if ((text[i + k] & 0xc0) != 0x80) return false;
+            value = (value << 6) | (text[i + k] & 0x3f);
+        }
+        if (value < MINIMUM[size] || (value >= 0xd800 && value <= 0xdfff)) return false;
+        i += size;
+    }
+    return true;
+}
+
+#pragma endregion
+
+//--------------------IO CONTEXT--------------------//
+#pragma region IO CONTEXT
+
+FdStreamBuf::FdStreamBuf(int fd) : m_fd(fd), m_failed(false), m_buffer(KB4) {
+    setp(m_buffer.data(), m_buffer.data() + m_buffer.size());
+}
+
+FdStreamBuf::~FdStreamBuf() {
+    flushBuffer();
+}
+
+bool FdStreamBuf::flushBuffer() {
+    char *data = pbase();
+    long left = pptr() - pbase();
+    while (left > 0 && !m_failed) {
+        long written = syscall(SYS_write, m_fd, data, left);
+        if (written == -1) {
+            if (errno == EINTR) continue;
+            m_failed = true;
+            break;
+        }
+        data += written;
+        left -= written;
+    }
+    setp(m_buffer.data(), m_buffer.data() + m_buffer.size());
+    return !m_failed;
+}
+
+int FdStreamBuf::overflow(int c) {
+    if (m_buffer.size() < OUTPUT_BUFFER_LIMIT) {
+        //grow instead of writing, the content moves with the vector
+        long used = pptr() - pbase();
+        m_buffer.resize(m_buffer.size() * 2);
+        setp(m_buffer.data(), m_buffer.data() + m_buffer.size());
+        pbump(used);
+    } else if (!flushBuffer()) {
+        return traits_type::eof();
+    }
+    if (c != traits_type::eof()) {
+        *pptr() = (char) c;
+        pbump(1);
+    }
+    return traits_type::not_eof(c);
+}
+
+int FdStreamBuf::sync() {
+    return flushBuffer() ? 0 : -1;
+}
+
+static FdStreamBuf s_shellOutBuf(STDOUT_FILENO);
+static std::ostream s_shellOut(&s_shellOutBuf);
+static thread_local IoContext t_io = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO, &s_shellOut, &std::cerr};
+
+//errors go out unbuffered, so pending output has to go first
+static struct ShellOutTie {
+    ShellOutTie() { std::cerr.tie(&s_shellOut); }
+} s_shellOutTie;
+
+const IoContext &currentIo() {
+    return t_io;
+}
+
+std::ostream &smashOut() {
+    return *t_io.m_out;
+}
+
+std::ostream &smashErr() {
+    return *t_io.m_err;
+}
+
+ScopedIo::ScopedIo(int inFd, int outFd, int errFd) : m_saved(t_io), m_outBuf(outFd), m_errBuf(errFd),
+                                                     m_out(&m_outBuf), m_err(&m_errBuf) {
+    t_io.m_inFd = inFd;
+    if (outFd != m_saved.m_outFd) {
+        t_io.m_out->flush();
+        t_io.m_outFd = outFd;
+        t_io.m_out = &m_out;
+    }
+    if (errFd != m_saved.m_errFd) {
+        t_io.m_err->flush();
+        t_io.m_errFd = errFd;
+        t_io.m_err = errFd == t_io.m_outFd ? t_io.m_out : &m_err;
+    }
+    m_err.tie(t_io.m_out);
+}
+
+ScopedIo::~ScopedIo() {
+    t_io.m_out->flush();
+    t_io.m_err->flush();
+    t_io = m_saved;
+}
+
+#pragma endregion
+
 //--------------------COMMAND::EXECUTE()--------------------//
 #pragma region COMMAND::EXECUTE()
 
@@ -392,7 +901,7 @@ void ChPromptCommand::execute() {
 
 void ShowPidCommand::execute() {
     pid_t pid = syscall(SYS_getpid);
-    cout << "smash pid is " << pid << endl;
+    smashOut() << "smash pid is " << pid << '\n';
 }
 
 void GetCurrDirCommand::execute() {
@@ -401,7 +910,108 @@ void GetCurrDirCommand::execute() {
         printError("getcwd");
         return;
     }
-    std::cout << cwd << std::endl;
+    smashOut() << cwd << '\n';
+}
+
+//job's timeout expired: signal its process group (and wake it up if it is stopped)
+static void fireTimer(JobsList::JobEntry &job) {
+    uint64_t expirations;
+    if (read(job.m_timerFd, &expirations, sizeof(expirations)) != sizeof(expirations)) return;
+    if (syscall(SYS_kill, -job.m_jobPID, job.m_timeoutSignal) == -1) printError("kill");
+    if (job.m_isStopped) syscall(SYS_kill, -job.m_jobPID, SIGCONT);
+    job.m_timedOut = true;
+    close(job.m_timerFd);
+    job.m_timerFd = -1;
+}
+
+//wait4 for the foreground child. once jobq/after/timeout are in use, background jobs exiting
+//or timing out meanwhile are handled right away instead of after the foreground one is done.
+//timed: the foreground command's own timeout
+static long waitForeground(pid_t pid, int *status, JobsList::JobEntry *timed = nullptr) {
+    uint64_t started = statTime();
+    SmallShell &smash = SmallShell::getInstance();
+    bool shellThread = smash.isShellThread();       //the job list is served from smash's thread only
+    std::vector<int> events;
+    if (shellThread) smash.jobEventFds(events);
+    int pidFd = events.empty() && timed == nullptr ? -1 : (int) syscall(SYS_pidfd_open, pid, 0);
+    if (pidFd != -1) {
+        std::vector<struct pollfd> fds;
+        while (true) {
+            //rebuilt every time, serviceJobs() closes the timers that fired
+            fds.assign(1, {pidFd, POLLIN, 0});
+            if (timed != nullptr && timed->m_timerFd != -1) fds.push_back({timed->m_timerFd, POLLIN, 0});
+            events.clear();
+            if (shellThread) smash.jobEventFds(events);
+            for (int fd: events) fds.push_back({fd, POLLIN, 0});
+            if (poll(fds.data(), fds.size(), -1) == -1) {
+                if (errno == EINTR) continue;
+                break;
+            }
+            if (fds[0].revents) break;
+            bool jobEvent = false;
+            for (size_t i = 1; i < fds.size(); i++) {
+                if (fds[i].revents == 0) continue;
+                if (timed != nullptr && fds[i].fd == timed->m_timerFd) fireTimer(*timed);
+                else jobEvent = true;
+            }
+            if (jobEvent) smash.serviceJobs();
+        }
+        close(pidFd);
+    }
+    long result = syscall(SYS_wait4, pid, status, 0, nullptr);
+    statRecord(STAT_WAIT, started);
+    return result;
+}
+
+//timerfd firing once after seconds, -1 (error printed) on failure
+static int armTimer(double seconds) {
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd == -1) {
+        printError("timerfd_create");
+        return -1;
+    }
+    struct itimerspec spec = {};
+    spec.it_value.tv_sec = (time_t) seconds;
+    spec.it_value.tv_nsec = (long) ((seconds - (double) spec.it_value.tv_sec) * 1e9);
+    if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0) spec.it_value.tv_nsec = 1;
+    if (timerfd_settime(fd, 0, &spec, nullptr) == -1) {
+        printError("timerfd_settime");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+//chdir that keeps OLDPWD and the frecency database up to date. false (error printed) if it failed
+static bool changeDirectory(const std::string &newPath) {
+    char cwd[PATH_MAX];
+    if (syscall(SYS_getcwd, cwd, PATH_MAX) == -1) {
+        printError("getcwd");
+        return false;
+    }
+    if (syscall(SYS_chdir, newPath.c_str()) == -1) {
+        printError("chdir");
+        return false;
+    }
+    SmallShell &smash = SmallShell::getInstance();
+    smash.setLastPWD(cwd);
+    //like history, only directories reached from a terminal are ranked
+    if (smash.isInteractive() && syscall(SYS_getcwd, cwd, PATH_MAX) != -1) smash.getDirIndex().visit(cwd);
+    return true;
+}
+
+static std::string currentDirectory() {
+    char cwd[PATH_MAX];
+    if (syscall(SYS_getcwd, cwd, PATH_MAX) == -1) return "";
+    return cwd;
+}
+
+//"cwd top ... bottom", like bash's dirs
+static void printDirStack() {
+    const std::vector<std::string> &stack = SmallShell::getInstance().getDirStack();
+    smashOut() << currentDirectory();
+    for (auto dir = stack.rbegin(); dir != stack.rend(); ++dir) smashOut() << ' ' << *dir;
+    smashOut() << '\n';
 }
 
 void ChangeDirCommand::execute() {
@@ -409,34 +1019,189 @@ void ChangeDirCommand::execute() {
         return;
     }
     if (m_argc > 2) {
-        std::cerr << "smash error: cd: too many arguments" << std::endl;
+        smashErr() << "smash error: cd: too many arguments" << std::endl;
         return;
     }
     std::string newPath;
-    if (m_argv[1] == "-") {
-        if (SmallShell::getInstance().getLastPWD() == "") {
-            std::cerr << "smash error: cd: OLDPWD not set" << std::endl;
+    if (strcmp(m_argv[1], "-") == 0) {
+        if (m_preChangePWD == "") {
+            smashErr() << "smash error: cd: OLDPWD not set" << std::endl;
             return;
         }
-        newPath = SmallShell::getInstance().getLastPWD();
-    } else if (m_argv[1][0] == '/') {
-        newPath = m_argv[1];
+        newPath = m_preChangePWD;
     } else {
-        char cwd[PATH_MAX];
-        if (syscall(SYS_getcwd, cwd, PATH_MAX) == -1) {
-            printError("getcwd");
+        newPath = m_argv[1];
+    }
+    changeDirectory(newPath);
+}
+
+void PushDirCommand::execute() {
+    std::vector<std::string> &stack = SmallShell::getInstance().getDirStack();
+    if (m_argc > 2) {
+        smashErr() << "smash error: pushd: too many arguments" << std::endl;
+        return;
+    }
+    std::string old = currentDirectory();
+    if (m_argc == 1) {
+        //swap the top two, like bash
+        if (stack.empty()) {
+            smashErr() << "smash error: pushd: no other directory" << std::endl;
             return;
         }
-        newPath = std::string(cwd) + "/" + m_argv[1];
+        if (!changeDirectory(stack.back())) return;
+        stack.back() = old;
+    } else {
+        if (!changeDirectory(m_argv[1])) return;
+        stack.push_back(old);
     }
-    if (syscall(SYS_chdir, newPath.c_str()) == -1) {
-        printError("chdir");
+    printDirStack();
+}
+
+void PopDirCommand::execute() {
+    std::vector<std::string> &stack = SmallShell::getInstance().getDirStack();
+    if (m_argc > 1) {
+        smashErr() << "smash error: popd: too many arguments" << std::endl;
+        return;
+    }
+    if (stack.empty()) {
+        smashErr() << "smash error: popd: directory stack empty" << std::endl;
+        return;
+    }
+    if (!changeDirectory(stack.back())) return;
+    stack.pop_back();
+    printDirStack();
+}
+
+void DirsCommand::execute() {
+    if (m_argc == 2 && strcmp(m_argv[1], "-c") == 0) {
+        SmallShell::getInstance().getDirStack().clear();
+        return;
+    }
+    if (m_argc != 1) {
+        smashErr() << "smash error: dirs: invalid arguments" << std::endl;
+        return;
+    }
+    printDirStack();
+}
+
+void JumpCommand::execute() {
+    bool list = m_argc >= 2 && strcmp(m_argv[1], "-l") == 0;
+    std::vector<std::string> terms(m_argv + 1 + list, m_argv + m_argc);
+    std::vector<std::pair<double, std::string>> matches;
+    SmallShell::getInstance().getDirIndex().match(terms, matches);
+    if (list || terms.empty()) {
+        //best last, like z -l
+        for (auto match = matches.rbegin(); match != matches.rend(); ++match) {
+            char score[32];
+            snprintf(score, sizeof(score), "%-10.1f ", match->first);
+            smashOut() << score << match->second << '\n';
+        }
         return;
     }
-    SmallShell::getInstance().setLastPWD(newPath);
+    for (const auto &match: matches) {
+        struct stat st;
+        if (stat(match.second.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+            changeDirectory(match.second);
+            return;
+        }
+    }
+    smashErr() << "smash error: z: no match" << std::endl;
+}
+
+//jobs -f: prints what the job writes from offset on as it comes, until its pipe reaches EOF or
+//ctrl-C. only smash's thread drains the pipe: here, serving the other jobs as well, or for a
+//pipeline stage while the pipeline waits (serveStages), and the stage is woken for new bytes
+static void followOutput(JobsList &jobs, JobOutput &output, uint64_t &offset) {
+    SmallShell &smash = SmallShell::getInstance();
+    bool shellThread = smash.isShellThread();
+    int outFd = currentIo().m_outFd;
+    smashOut().flush();
+    std::vector<int> events;
+    std::vector<struct pollfd> fds;
+    if (shellThread) takeCtrlC();
+    std::string text;
+    while (true) {
+        bool open = jobs.readOutput(output, offset, text);
+        if (!writeAll(outFd, text.data(), text.size())) return;     //the reader is gone
+        if (!open) return;
+        if (!shellThread) {
+            if (ctrlCPending()) return;     //smash's thread takes it once the pipeline is done
+            jobs.waitOutput(output, offset);
+            continue;
+        }
+        events.clear();
+        smash.jobEventFds(events);      //the capture pipes among them
+        fds.clear();
+        for (int fd: events) fds.push_back({fd, POLLIN, 0});
+        if (poll(fds.data(), fds.size(), -1) == -1) {
+            if (errno == EINTR && takeCtrlC()) return;
+            continue;
+        }
+        smash.serviceJobs();
+    }
+}
+
+bool JobsCommand::needsShellThread() const {
+    return !followsJobOutput();
+}
+
+bool JobsCommand::followsJobOutput() const {
+    return m_argc == 3 && strcmp(m_argv[1], "-f") == 0;
 }
 
 void JobsCommand::execute() {
+    if (m_argc == 2 && strcmp(m_argv[1], "-d") == 0) {
+        m_jobsListRef.printFinishedJobs();
+        return;
+    }
+    if (m_argc >= 2 && strcmp(m_argv[1], "-c") == 0) {
+        if (m_argc == 2) {
+            smashOut() << "capture: " << (m_jobsListRef.getCaptureOn() ? "on" : "off") << ", "
+                       << m_jobsListRef.getCaptureJobCap() << " bytes per job, "
+                       << m_jobsListRef.getCaptureTotalCap() << " in all, " << m_jobsListRef.getCapturedBytes()
+                       << " used" << '\n';
+            return;
+        }
+        bool on = strcmp(m_argv[2], "on") == 0;
+        int jobCap = (int) m_jobsListRef.getCaptureJobCap(), totalCap = (int) m_jobsListRef.getCaptureTotalCap();
+        if ((!on && (strcmp(m_argv[2], "off") != 0 || m_argc != 3)) || m_argc > 5 ||
+            (m_argc >= 4 && (!parseSize(m_argv[3], jobCap) || jobCap == 0)) ||
+            (m_argc == 5 && (!parseSize(m_argv[4], totalCap) || totalCap == 0))) {
+            smashErr() << "smash error: jobs: invalid arguments" << std::endl;
+            return;
+        }
+        if (on) installChildHandler();      //a job's last output is read when it exits
+        m_jobsListRef.setCapture(on, jobCap, totalCap);
+        return;
+    }
+    bool follow = m_argc == 3 && strcmp(m_argv[1], "-f") == 0;
+    if (m_argc == 3 && (follow || strcmp(m_argv[1], "-o") == 0)) {
+        if (!allDigits(m_argv[2])) {
+            smashErr() << "smash error: jobs: invalid arguments" << std::endl;
+            return;
+        }
+        std::shared_ptr<JobOutput> output = m_jobsListRef.getOutput(atoi(m_argv[2]));
+        if (output == nullptr) {
+            smashErr() << "smash error: jobs: job-id " << m_argv[2] << " has no captured output" << std::endl;
+            return;
+        }
+        //a stage thread takes what smash's thread drained so far
+        bool shellThread = SmallShell::getInstance().isShellThread();
+        for (uint64_t before = UINT64_MAX; shellThread && output->m_fd != -1 && output->m_written != before;) {
+            before = output->m_written;
+            m_jobsListRef.drainOutput(*output);
+        }
+        uint64_t offset = 0;
+        std::string text;
+        m_jobsListRef.readOutput(*output, offset, text);
+        if (offset > text.size()) {
+            smashErr() << "smash: jobs: the first " << offset - text.size() << " bytes of job-id "
+                       << m_argv[2] << " were dropped" << std::endl;
+        }
+        smashOut() << text;
+        if (follow) followOutput(m_jobsListRef, *output, offset);
+        return;
+    }
     m_jobsListRef.printJobsList();
 }
 
@@ -447,35 +1212,42 @@ void ForegroundCommand::execute() {
     //ERROR HANDLING + VALUE EXTRACTION
     //taking care of no args case error, if JobsList is empty we get nullptr from getLastJob(&jobId)
     if (this->m_argc == 1 && job == nullptr) {
-        std::cerr << "smash error: fg: jobs list is empty" << std::endl;
+        smashErr() << "smash error: fg: jobs list is empty" << std::endl;
         return;
     }
     //if we have arguments we need to fix the values to the correct ones. ELSE WE ALREADY GOT THEM!
     if (this->m_argc != 1) {
         //taking care of too many arguments.
         if (this->m_argc > 2) {
-            std::cerr << "smash error: fg: invalid arguments" << std::endl;
+            smashErr() << "smash error: fg: invalid arguments" << std::endl;
             return;
         }
         //here we get for sure 2 arguments - extracting the jobId StoI
         try {
             jobId = stoi((this->m_argv[1]));
         } catch (const std::invalid_argument &error) {
-            std::cerr << "smash error: fg: invalid arguments" << std::endl;
+            smashErr() << "smash error: fg: invalid arguments" << std::endl;
             return;
         }
         //here we extracted a jobId successfully
         job = this->m_jobsListRef.getJobById(jobId);
         if (job == nullptr) {
-            std::cerr << "smash error: fg: job-id " << jobId << " does not exist" << std::endl;
+            smashErr() << "smash error: fg: job-id " << jobId << " does not exist" << std::endl;
             return;
         }
     }
 
     //WE GOT CORRECT VALUES FOR THE JOB! -----> COMMAND LOGIC
+    if (job->m_isWaiting) {
+        smashErr() << "smash error: fg: job-id " << jobId << " is waiting for other jobs" << std::endl;
+        return;
+    }
+    if (job->m_isQueued && !m_jobsListRef.startJob(jobId)) return;
     pid_t pid = job->m_jobPID;
+    SmallShell::getInstance().setFgProcCmd(job->m_jobCommandString.c_str());
     SmallShell::getInstance().setFgProcPID(pid);
-    std::cout << job->m_jobCommandString << " " << pid << std::endl;
+    smashOut() << job->m_jobCommandString << " " << pid << '\n';
+    smashOut().flush();
 
     // const pid_t smashPID = syscall(SYS_getpid);
     // //give terminal control to the job
@@ -489,46 +1261,132 @@ void ForegroundCommand::execute() {
     // syscall(SYS_tcsetpgrp, STDIN_FILENO, smashPID);
 
 //    if (syscall(SYS_wait4, pid, nullptr, 0, nullptr) == -1) printError("waitpid");
-    long result = syscall(SYS_wait4, pid, nullptr, 0, nullptr);
+    int status;
+    long result = waitForeground(pid, &status);
     if (result == -1) {
         if (errno != ECHILD) {
             printError("waitpid");
         }
+    } else {
+        m_jobsListRef.addFinishedJob(job->m_jobCommandString, pid, jobId, status, job->m_startTime, job->m_timedOut);
     }
-    SmallShell::getInstance().setFgProcPID(-1);
-    this->m_jobsListRef.removeJobById(jobId);
+    SmallShell::getInstance().clearFgJob();     //m_fgCmd points into the job
+    this->m_jobsListRef.removeJobById(jobId, result != -1 && WIFEXITED(status) && WEXITSTATUS(status) == 0);
 }
 
 void QuitCommand::execute() {
-    bool withKill = (m_argc >= 2) && (std::string(m_argv[1]) == "kill");
+    bool withKill = (m_argc >= 2) && strcmp(m_argv[1], "kill") == 0;
     if (withKill) {
         m_jobsListRef.killAllJobs();
     }
     m_jobsListRef.removeFinishedJobs();
     //maybe free memory?
+    smashOut().flush();
+    SmallShell::getInstance().removeStatusPage();
     syscall(SYS_exit, 0);
 }
 
+//the jobs a kill operand names, in id order: %N-%M or N-M (the ids that exist), %running,
+//%stopped, %?text. false if it is none of these
+static bool selectJobs(const char *operand, JobsList &jobs, std::vector<int> &ids) {
+    bool percent = operand[0] == '%';
+    const char *rest = operand + percent;
+    bool running = percent && strcmp(rest, "running") == 0, stopped = percent && strcmp(rest, "stopped") == 0;
+    std::string text;
+    int first = 0, last = -1;
+    if (percent && rest[0] == '?') {
+        text = rest + 1;
+        if (text.empty()) return false;
+    } else if (!running && !stopped) {
+        const char *dash = strchr(rest, '-');
+        if (dash == nullptr) return false;
+        std::string from(rest, dash - rest), to(dash + 1 + (percent && dash[1] == '%'));
+        if (!allDigits(from.c_str()) || !allDigits(to.c_str())) return false;
+        first = atoi(from.c_str());
+        last = atoi(to.c_str());
+    }
+    for (const auto &entry: jobs.getJobs()) {
+        const JobsList::JobEntry &job = entry.second;
+        if (job.m_isQueued) continue;       //nothing to signal yet
+        bool selected;
+        if (running) selected = !job.m_isStopped;
+        else if (stopped) selected = job.m_isStopped;
+        else if (!text.empty()) selected = job.m_jobCommandString.find(text) != std::string::npos;
+        else selected = entry.first >= first && entry.first <= last;
+        if (selected && std::find(ids.begin(), ids.end(), entry.first) == ids.end()) ids.push_back(entry.first);
+    }
+    return true;
+}
+
 void KillCommand::execute() {
-    if (m_argc != 3 || m_argv[1][0] != '-') {
-        std::cerr << "smash error: kill: invalid arguments" << std::endl;
+    if (m_argc < 3 || m_argv[1][0] != '-') {
+        smashErr() << "smash error: kill: invalid arguments" << std::endl;
         return;
     }
     int signum, jobId;
     try {
         signum = std::stoi(m_argv[1]) * -1;
-        jobId = std::stoi(m_argv[2]);
+        if (m_argc == 3 && m_argv[2][0] != '%' && strchr(m_argv[2] + 1, '-') == nullptr) {
+            jobId = std::stoi(m_argv[2]);
+        } else {
+            jobId = -1;
+        }
     } catch (...) {
-        std::cerr << "smash error: kill: invalid arguments" << std::endl;
+        smashErr() << "smash error: kill: invalid arguments" << std::endl;
         return;
     }
-    JobsList::JobEntry *job = m_jobsListRef.getJobById(jobId);
+    if (jobId == -1) {
+        //a whole set of jobs at once, each through its pidfd
+        std::vector<int> ids;
+        bool missing = false;
+        m_jobsListRef.removeFinishedJobs();
+        for (int i = 2; i < m_argc; i++) {
+            const char *operand = m_argv[i];
+            if (allDigits(operand + (operand[0] == '%'))) {
+                int id = atoi(operand + (operand[0] == '%'));
+                JobsList::JobEntry *job = m_jobsListRef.getJobById(id);
+                if (job == nullptr || job->m_isQueued) {
+                    missing = true;
+                    smashErr() << "smash error: kill: job-id " << id
+                               << (job == nullptr ? " does not exist" : " is queued") << std::endl;
+                } else if (std::find(ids.begin(), ids.end(), id) == ids.end()) {
+                    ids.push_back(id);
+                }
+            } else if (!selectJobs(operand, m_jobsListRef, ids)) {
+                smashErr() << "smash error: kill: invalid arguments" << std::endl;
+                return;
+            }
+        }
+        if (ids.empty()) {
+            if (!missing) smashErr() << "smash error: kill: no jobs match" << std::endl;
+            return;
+        }
+        size_t sent = 0;
+        for (int id: ids) {
+            const JobsList::JobEntry &job = m_jobsListRef.getJobs().at(id);
+            if (m_jobsListRef.signalJob(job, signum)) {
+                smashOut() << "signal number " << signum << " was sent to pid " << job.m_jobPID << '\n';
+                sent++;
+            } else {
+                int savedErrno = errno;
+                smashErr() << "smash error: kill: job-id " << id << " (pid " << job.m_jobPID << "): "
+                           << strerror(savedErrno) << std::endl;
+            }
+        }
+        if (ids.size() > 1) smashOut() << "smash: signal sent to " << sent << " of " << ids.size() << " jobs" << '\n';
+        return;
+    }
+    JobsList::JobEntry *job = m_jobsListRef.getJobById(jobId);
     if (!job) {
-        std::cerr << "smash error: kill: job-id " << jobId << " does not exist" << std::endl;
+        smashErr() << "smash error: kill: job-id " << jobId << " does not exist" << std::endl;
+        return;
+    }
+    if (job->m_isQueued) {
+        smashErr() << "smash error: kill: job-id " << jobId << " is queued" << std::endl;
         return;
     }
-    std::cout << "signal number " << signum << " was sent to pid " << job->m_jobPID << std::endl;
-    if (syscall(SYS_kill, job->m_jobPID, signum) == -1) {
+    smashOut() << "signal number " << signum << " was sent to pid " << job->m_jobPID << '\n';
+    if (!m_jobsListRef.signalJob(*job, signum)) {
         printError("kill");
         return;
     }
@@ -541,50 +1399,50 @@ void AliasCommand::execute() {
     if (m_argc == 1) {
         //only alias without args print aliasMap
         for (const auto &p: smash.m_aliasMap)
-            std::cout << p.first << "='" << p.second << "'" << std::endl;
+            smashOut() << p.first << "='" << p.second << "'" << '\n';
         return;
     }
     //check validation of args
-    std::string stripped = m_cmdLine.substr(
-            m_cmdLine.find("alias") + 5);
+    std::string cmdLine(m_cmdLine);
+    std::string stripped = cmdLine.substr(
+            cmdLine.find("alias") + 5);
     stripped = _trim(stripped);
     size_t equalPos = stripped.find('=');
     if (equalPos == std::string::npos) {
-        std::cerr << "smash error: alias: invalid alias format" << std::endl;
+        smashErr() << "smash error: alias: invalid alias format" << std::endl;
         return;
     }
     std::string name = _trim(stripped.substr(0, equalPos));
     std::string value = _trim(stripped.substr(equalPos + 1));
     if (value.size() < 2 || value.front() != '\'' || value.back() != '\'') {
-        std::cerr << "smash error: alias: invalid alias format" << std::endl;
+        smashErr() << "smash error: alias: invalid alias format" << std::endl;
         return;
     }
     value = value.substr(1, value.size() - 2);
 //    std::regex rx("^\\s*([A-Za-z0-9_]+)='([^']*)'\\s*$");
 //    std::smatch m;
 //    if (!std::regex_match(stripped, m, rx)) {
-//        std::cerr << "smash error: alias: invalid alias format" << std::endl;
+//        smashErr() << "smash error: alias: invalid alias format" << std::endl;
 //        return;
 //    }
 //    std::string name = m[1], cmd = m[2];
-    static const unordered_set<std::string> reserved = {
-            "quit", "jobs", "fg", "cd", "pwd", "showpid", "kill",
-            "alias", "unalias", "watchproc", "unsetenv", "chprompt",
-            "du", "whoami", "netinfo"
-    };
-    if (smash.m_aliasMap.count(name) || reserved.count(name)) {
-        std::cerr << "smash error: alias: " << name
+    if (smash.m_aliasMap.count(name) || findBuiltin(name.c_str(), name.size())) {
+        smashErr() << "smash error: alias: " << name
                   << " already exists or is a reserved command" << std::endl;
         return;
     }
     smash.m_aliasMap[name] = value;
+    if (!smash.aliasesChanged()) {
+        smash.m_aliasMap.erase(name);
+        smashErr() << "smash error: alias: " << name << " would create an alias loop" << std::endl;
+    }
 
 }
 
 void UnAliasCommand::execute() {
     SmallShell &smash = SmallShell::getInstance();
     if (m_argc == 1) {
-        cerr << "smash error: unalias: not enough arguments" << std::endl;
+        smashErr() << "smash error: unalias: not enough arguments" << std::endl;
         return;
     }
     if (m_argc >= 2) {
@@ -592,17 +1450,18 @@ void UnAliasCommand::execute() {
             string name = m_argv[i];
             auto iter = smash.m_aliasMap.find(name);
             if (iter == smash.m_aliasMap.end()) {
-                cerr << "smash error: unalias: " << name << " alias does not exist" << std::endl;
+                smashErr() << "smash error: unalias: " << name << " alias does not exist" << std::endl;
                 return;
             }
             smash.m_aliasMap.erase(iter);
+            smash.aliasesChanged();
         }
     }
 }
 
 void UnSetEnvCommand::execute() {
     if (m_argc <= 1) {
-        std::cerr << "smash error: unsetenv: not enough arguments" << std::endl;
+        smashErr() << "smash error: unsetenv: not enough arguments" << std::endl;
         return;
     }
 
@@ -610,12 +1469,12 @@ void UnSetEnvCommand::execute() {
         std::string var = m_argv[i];
 
         if (!envVarExists(var)) {
-            std::cerr << "smash error: unsetenv: " << var << " does not exist" << std::endl;
+            smashErr() << "smash error: unsetenv: " << var << " does not exist" << std::endl;
             return;
         }
 
         if (!removeEnvVar(var)) {
-            std::cerr << "smash error: unsetenv failed" << std::endl;
+            smashErr() << "smash error: unsetenv failed" << std::endl;
             return;
         }
     }
@@ -625,18 +1484,18 @@ void WatchProcCommand::execute() {
     pid_t pid;
     //==================================Error Handling===================================//
     if (m_argc != 2) {
-        std::cerr << "smash error: watchproc: invalid arguments" << std::endl;
+        smashErr() << "smash error: watchproc: invalid arguments" << std::endl;
         return;
     }
     try {
         pid = std::stoi(m_argv[1]);
     } catch (const std::invalid_argument &error) {
-        std::cerr << "smash error: watchproc: invalid arguments" << std::endl;
+        smashErr() << "smash error: watchproc: invalid arguments" << std::endl;
         return;
     }
     //check if PID doesnt exist
     if (syscall(SYS_kill, pid, 0) == -1 && errno == ESRCH) {
-        std::cerr << "smash error: watchproc: pid " << pid << " does not exist " << std::endl;
+        smashErr() << "smash error: watchproc: pid " << pid << " does not exist " << std::endl;
         return;
     }
     //==================================Parsing Files===================================//
@@ -652,7 +1511,7 @@ void WatchProcCommand::execute() {
 
     //1sec sleep interval
     struct timespec ts = {0, 1000000000}; //yonadav: create an object insted of &
-    syscall(SYS_nanosleep, &ts, NULL);
+    while (syscall(SYS_nanosleep, &ts, &ts) == -1 && errno == EINTR) {}    //SIGCHLD with the job queue on
 
     std::string systemStat2 = readFile("/proc/stat");
 //    std::string totalUptime2 = readFile(totalUptime);
@@ -691,7 +1550,7 @@ void WatchProcCommand::execute() {
 
     if (!parseUtimeStime(procStat1, utime1, stime1) ||
         !parseUtimeStime(procStat2, utime2, stime2)) {
-        std::cerr << "smash error: watchproc: failed to parse /proc data" << std::endl;
+        smashErr() << "smash error: watchproc: failed to parse /proc data" << std::endl;
         return;
     }
 
@@ -711,7 +1570,7 @@ void WatchProcCommand::execute() {
     unsigned long long totalTicks1 = 0, totalTicks2 = 0;
     if (!parseTotalCpuTicks(systemStat1, totalTicks1) ||
         !parseTotalCpuTicks(systemStat2, totalTicks2)) {
-        std::cerr << "smash error: watchproc: failed to parse /proc/stat" << std::endl;
+        smashErr() << "smash error: watchproc: failed to parse /proc/stat" << std::endl;
         return;
     }
     unsigned long long totalTicksDelta = totalTicks2 - totalTicks1;
@@ -729,335 +1588,2304 @@ void WatchProcCommand::execute() {
                            static_cast<double>(totalTicksDelta)) * 100.0;
     }
     //==================================Printing===================================//
-    std::cout << "PID: " << pid
+    smashOut() << "PID: " << pid
               << " | CPU Usage: " << std::fixed << std::setprecision(1) << cpuUsagePercent << "%"
               << " | Memory Usage: " << std::fixed << std::setprecision(1) << memoryUsageMB << " MB"
-              << std::endl;
+              << '\n';
 }
 
-void RedirectionCommand::execute() {
-    int flags = O_WRONLY | O_CREAT | (m_override ? O_TRUNC : O_APPEND);
-    int mode = 0666; //read+write for everyone
-    int fd = syscall(SYS_open, m_outPathPart.c_str(), flags, mode);
-    if (fd == -1) {
-        printError("open");
-        return;
+void CatCommand::execute() {
+    for (int i = 1; i < m_argc; ++i) {
+        if (m_argv[i][0] == '-' && strcmp(m_argv[i], "-") != 0) {
+            //flags are coreutils' business
+            ExternalCommand(m_cmdLine).execute();
+            return;
+        }
     }
-    int stdoutBackup = dup(STDOUT_FILENO);  //backup stdout
-    if (stdoutBackup == -1) {
-        printError("dup");
-        close(fd);
+    const IoContext &io = currentIo();
+    smashOut().flush();
+    if (m_argc == 1) {
+        transferFd(io.m_inFd, io.m_outFd);
         return;
     }
-    if (dup2(fd, STDOUT_FILENO) == -1) {
-        printError("dup2");
+    for (int i = 1; i < m_argc; ++i) {
+        if (strcmp(m_argv[i], "-") == 0) {
+            if (!transferFd(io.m_inFd, io.m_outFd)) return;
+            continue;
+        }
+        int fd = syscall(SYS_open, m_argv[i], O_RDONLY | O_CLOEXEC);
+        if (fd == -1) {
+            smashErr() << "smash error: cat: " << m_argv[i] << ": " << strerror(errno) << std::endl;
+            continue;
+        }
+        bool ok = transferFd(fd, io.m_outFd);
         close(fd);
-        close(stdoutBackup);
-        return;
+        if (!ok) return;
     }
-    close(fd);
-    SmallShell &smash = SmallShell::getInstance();
-    smash.CreateCommand(m_commandPart.c_str())->execute();
-    if (dup2(stdoutBackup, STDOUT_FILENO) == -1) {
-        printError("dup2");
+}
+
+void TeeCommand::execute() {
+    bool append = false;
+    std::vector<std::string> paths;
+    for (int i = 1; i < m_argc; ++i) {
+        if (strcmp(m_argv[i], "-a") == 0) {
+            append = true;
+        } else if (m_argv[i][0] == '-' && strcmp(m_argv[i], "-") != 0) {
+            ExternalCommand(m_cmdLine).execute();
+            return;
+        } else {
+            paths.push_back(m_argv[i]);
+        }
+    }
+    std::vector<int> fds;
+    int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (append ? O_APPEND : O_TRUNC);
+    for (const std::string &path: paths) {
+        int fd = syscall(SYS_open, path.c_str(), flags, 0666);
+        if (fd == -1) {
+            smashErr() << "smash error: tee: " << path << ": " << strerror(errno) << std::endl;
+            continue;
+        }
+        fds.push_back(fd);
     }
-    close(stdoutBackup);
+    const IoContext &io = currentIo();
+    smashOut().flush();
+    if (fds.size() > 1 || !teePipe(io.m_inFd, io.m_outFd, fds.empty() ? -1 : fds[0])) {
+        std::vector<char> buffer(TRANSFER_CHUNK / 8);
+        while (true) {
+            long bytesRead = syscall(SYS_read, io.m_inFd, buffer.data(), buffer.size());
+            if (bytesRead == -1 && errno == EINTR) continue;
+            if (bytesRead <= 0) break;
+            writeAll(io.m_outFd, buffer.data(), bytesRead);
+            for (int fd: fds) writeAll(fd, buffer.data(), bytesRead);
+        }
+    }
+    for (int fd: fds) close(fd);
 }
 
-void PipeCommand::execute() {
-    SmallShell &smash = SmallShell::getInstance();
-    int fd[2];
-    if (pipe(fd) == -1) {
-        printError("pipe");
-        return;
+void WordCountCommand::execute() {
+    bool lines = false, bytes = false, known = true, endOfOptions = false;
+    std::vector<const char *> operands;
+    for (int i = 1; i < m_argc; ++i) {
+        const char *arg = m_argv[i];
+        if (endOfOptions || arg[0] != '-' || arg[1] == '\0') {
+            operands.push_back(arg);
+        } else if (strcmp(arg, "--") == 0) {
+            endOfOptions = true;
+        } else if (strcmp(arg, "--lines") == 0) {
+            lines = true;
+        } else if (strcmp(arg, "--bytes") == 0) {
+            bytes = true;
+        } else {
+            for (const char *flag = arg + 1; *flag; ++flag) {
+                if (*flag == 'l') lines = true;
+                else if (*flag == 'c') bytes = true;
+                else known = false;
+            }
+        }
     }
-    pid_t pid1 = fork();
-    if (pid1 < 0) {
-        printError("fork");
+    std::vector<TextInput> inputs;
+    if (!known || (!lines && !bytes) || m_isBackgroundCommand || !SmallShell::getInstance().getTextBuiltins() ||
+        !openTextInputs(operands, inputs)) {
+        runTextTool(*this);
         return;
     }
-    if (pid1 == 0) {        // first child
-        setpgrp();
-        close(fd[0]); // Close stdin
-        if (m_toStderr) {
-            dup2(fd[1], STDERR_FILENO);
+    //coreutils' column width: 1 for one count of one input, else the digits of the regular
+    //files' total size, at least 7 when an input is not a regular file
+    int width = 1;
+    std::vector<struct stat> stats(inputs.size());
+    bool statsValid = true;
+    for (size_t i = 0; i < inputs.size(); ++i) statsValid = fstat(inputs[i].m_fd, &stats[i]) == 0 && statsValid;
+    if (inputs.size() > 1 || (lines && bytes)) {
+        int minimum = 1;
+        unsigned long long regularTotal = 0;
+        for (const struct stat &st: stats) {
+            if (S_ISREG(st.st_mode)) regularTotal += st.st_size;
+            else minimum = 7;
+        }
+        for (; regularTotal >= 10; regularTotal /= 10) width++;
+        width = std::max(width, minimum);
+    }
+    std::vector<char> buffer(TEXT_BLOCK);
+    unsigned long long totalLines = 0, totalBytes = 0;
+    char row[64];
+    smashOut().flush();
+    TextSink sink(currentIo().m_outFd);
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        unsigned long long lineCount = 0, byteCount = 0;
+        off_t position;
+        //-c alone on a regular file: its size, without reading it. sizes that are a multiple of
+        //the page size may be /proc files that claim one (0 included), coreutils reads those too
+        if (!lines && statsValid && S_ISREG(stats[i].st_mode) && stats[i].st_size % getpagesize() != 0 &&
+            (position = lseek(inputs[i].m_fd, 0, SEEK_CUR)) != -1) {
+            byteCount = stats[i].st_size > position ? stats[i].st_size - position : 0;
+            lseek(inputs[i].m_fd, 0, SEEK_END);
         } else {
-            dup2(fd[1], STDOUT_FILENO);
+            long bytesRead;
+            while ((bytesRead = readRetry(inputs[i].m_fd, buffer.data(), buffer.size())) > 0) {
+                if (lines) lineCount += countByte(buffer.data(), bytesRead, '\n');
+                byteCount += bytesRead;
+            }
+            if (bytesRead == -1 && errno == EINTR) {        //ctrl-C: no counts, like a killed wc
+                closeTextInputs(inputs);
+                return;
+            }
+        }
+        totalLines += lineCount;
+        totalBytes += byteCount;
+        int length = 0;
+        if (lines) length += snprintf(row + length, sizeof(row) - length, "%*llu", width, lineCount);
+        if (bytes) length += snprintf(row + length, sizeof(row) - length, lines ? " %*llu" : "%*llu", width, byteCount);
+        sink.append(row, length);
+        if (inputs[i].m_name != nullptr) {
+            sink.append(" ", 1);
+            sink.append(inputs[i].m_name, strlen(inputs[i].m_name));
         }
-        close(fd[1]);
-        smash.CreateCommand(m_leftCmd.c_str())->execute();
-        exit(0);
+        sink.append("\n", 1);
+    }
+    if (inputs.size() > 1) {
+        int length = 0;
+        if (lines) length += snprintf(row + length, sizeof(row) - length, "%*llu", width, totalLines);
+        if (bytes) length += snprintf(row + length, sizeof(row) - length, lines ? " %*llu" : "%*llu", width, totalBytes);
+        sink.append(row, length);
+        sink.append(" total\n", 7);
+    }
+    closeTextInputs(inputs);
+}
 
+void HeadCommand::execute() {
+    unsigned long long count = 10;
+    bool byBytes = false, known = true, endOfOptions = false;
+    std::vector<const char *> operands;
+    for (int i = 1; i < m_argc; ++i) {
+        const char *arg = m_argv[i];
+        if (endOfOptions || arg[0] != '-' || arg[1] == '\0') {
+            operands.push_back(arg);
+            continue;
+        }
+        if (strcmp(arg, "--") == 0) {
+            endOfOptions = true;
+            continue;
+        }
+        const char *value = nullptr;
+        if (i == 1 && allDigits(arg + 1)) {          //the obsolete head -N, first argument only
+            value = arg + 1;
+            byBytes = false;
+        } else if (strncmp(arg, "--lines=", 8) == 0 || strncmp(arg, "--bytes=", 8) == 0) {
+            value = arg + 8;
+            byBytes = arg[2] == 'b';
+        } else if (arg[1] == 'n' || arg[1] == 'c') {
+            byBytes = arg[1] == 'c';
+            value = arg[2] != '\0' ? arg + 2 : i + 1 < m_argc ? m_argv[++i] : nullptr;
+        }
+        //negative counts and size suffixes are left to coreutils
+        if (value == nullptr || !allDigits(value) || strlen(value) > 18) {
+            known = false;
+            continue;
+        }
+        count = strtoull(value, nullptr, 10);
     }
-    pid_t pid2 = fork();
-    if (pid2 < 0) {
-        printError("fork");
+    std::vector<TextInput> inputs;
+    if (!known || m_isBackgroundCommand || !SmallShell::getInstance().getTextBuiltins() ||
+        !openTextInputs(operands, inputs)) {
+        runTextTool(*this);
         return;
     }
-    if (pid2 == 0) {        // second child
-        setpgrp();
-
-        close(fd[1]); // Close stdout
-        dup2(fd[0], STDIN_FILENO);
-        close(fd[0]);
-        smash.CreateCommand(m_rightCmd.c_str())->execute();
-        exit(0);
+    std::vector<char> buffer(TEXT_BLOCK);
+    smashOut().flush();
+    TextSink sink(currentIo().m_outFd);
+    bool interrupted = false;
+    for (size_t i = 0; i < inputs.size() && !sink.failed() && !interrupted; ++i) {
+        if (inputs.size() > 1) {
+            const char *name = strcmp(inputs[i].m_name, "-") == 0 ? "standard input" : inputs[i].m_name;
+            sink.append(std::string(i > 0 ? "\n" : "") + "==> " + name + " <==\n");
+        }
+        unsigned long long remaining = count;
+        while (remaining > 0 && !sink.failed()) {
+            size_t wanted = byBytes ? (size_t) std::min<unsigned long long>(remaining, buffer.size()) : buffer.size();
+            long bytesRead = readRetry(inputs[i].m_fd, buffer.data(), wanted);
+            interrupted = bytesRead == -1 && errno == EINTR;
+            if (bytesRead <= 0) break;
+            size_t take = bytesRead;
+            if (byBytes) {
+                remaining -= take;
+            } else {
+                size_t newlines = countByte(buffer.data(), bytesRead, '\n');
+                if (newlines < remaining) {
+                    remaining -= newlines;
+                } else {
+                    const char *end = buffer.data();
+                    for (; remaining > 0; remaining--) {
+                        end = static_cast<const char *>(memchr(end, '\n', buffer.data() + bytesRead - end)) + 1;
+                    }
+                    take = end - buffer.data();
+                    //like coreutils: leave a seekable input right after the last line shown
+                    if (take < (size_t) bytesRead) lseek(inputs[i].m_fd, (off_t) take - bytesRead, SEEK_CUR);
+                }
+            }
+            sink.append(buffer.data(), take);
+            sink.flush();
+        }
     }
-    close(fd[0]);
-    close(fd[1]);
+    closeTextInputs(inputs);
+}
 
-    waitpid(pid1, nullptr, 0);
-    waitpid(pid2, nullptr, 0);
+struct GrepOptions {
+    std::string m_pattern;
+    bool m_invert;
+    bool m_count;
+    bool m_lineNumbers;
+    bool m_quiet;
+    bool m_withNames;
+    bool m_utf8;
+    bool m_lineBuffered;        //a terminal gets every line at once, like grep's stdio
+};
 
+//grep -F over one input into sink. false once -q found a line or on ctrl-C: nothing else
+//needs reading
+static bool grepInput(const GrepOptions &options, int fd, const char *name, TextSink &sink) {
+    std::vector<char> buffer(TEXT_BLOCK + 1);
+    size_t kept = 0;                        //the unfinished line at the front of buffer
+    unsigned long long matches = 0, lineNumber = 0;
+    bool binary = false, binaryMatched = false, encodingError = false, eof = false;
+    std::string prefix = options.m_withNames ? std::string(name) + ":" : "";
+    while (!eof && !binaryMatched && !sink.failed()) {
+        if (kept + 1 >= buffer.size()) buffer.resize(buffer.size() * 2);
+        long bytesRead = readRetry(fd, buffer.data() + kept, buffer.size() - kept - 1);
+        if (bytesRead == -1 && errno == EINTR) return false;
+        if (bytesRead < 0) break;
+        char *chunk = buffer.data() + kept;
+        if (bytesRead == 0) {
+            eof = true;
+            if (kept == 0) break;
+            chunk[bytesRead++] = '\n';      //grep ends an unterminated last line
+        }
+        //NUL bytes make the input binary from this read on: lines are no longer printed and
+        //the NULs split lines, as grep does from the buffer it found them in
+        if (!binary && memchr(chunk, '\0', bytesRead) != nullptr) binary = true;
+        if (binary) {
+            for (char *nul = chunk; (nul = static_cast<char *>(memchr(nul, '\0', chunk + bytesRead - nul)));) {
+                *nul = '\n';
+            }
+        }
+        char *begin = buffer.data(), *dataEnd = chunk + bytesRead;
+        char *lastNewline = static_cast<char *>(memrchr(begin, '\n', dataEnd - begin));
+        if (lastNewline == nullptr) {
+            kept += bytesRead;
+            continue;
+        }
+        const char *end = lastNewline + 1;
+        const char *at = begin;
+        while (at < end) {
+            const char *match = findLiteral(at, end - at, options.m_pattern.data(), options.m_pattern.size());
+            const char *lineStart = end, *lineEnd = end;
+            if (match != nullptr) {
+                const char *newline = static_cast<const char *>(memrchr(at, '\n', match - at));
+                lineStart = newline != nullptr ? newline + 1 : at;
+                lineEnd = static_cast<const char *>(memchr(match, '\n', end - match)) + 1;
+            }
+            //the selected lines: the one matching, or with -v every line before it
+            const char *selected = options.m_invert ? at : lineStart;
+            const char *selectedEnd = options.m_invert ? lineStart : lineEnd;
+            while (selected < selectedEnd) {
+                const char *next = static_cast<const char *>(memchr(selected, '\n', selectedEnd - selected)) + 1;
+                if (options.m_quiet) return false;
+                matches++;
+                if (options.m_lineNumbers) lineNumber += countByte(at, selected - at, '\n') + 1;
+                at = next;
+                if (options.m_count) {
+                    if (!options.m_lineNumbers && options.m_invert) {
+                        //no per-line work to do: count the rest of the run at once
+                        matches += countByte(next, selectedEnd - next, '\n');
+                        at = selectedEnd;
+                        break;
+                    }
+                } else if (binary) {
+                    binaryMatched = true;
+                    break;
+                } else if (options.m_utf8 && !isValidUtf8(reinterpret_cast<const unsigned char *>(selected),
+                                                           next - selected - 1)) {
+                    encodingError = true;
+                } else {
+                    sink.append(prefix);
+                    if (options.m_lineNumbers) sink.append(std::to_string(lineNumber) + ":");
+                    sink.append(selected, next - selected);
+                }
+                selected = next;
+            }
+            if (binaryMatched) break;
+            if (options.m_lineNumbers) lineNumber += countByte(at, lineEnd - at, '\n');
+            at = lineEnd;
+        }
+        if (options.m_lineBuffered) sink.flush();
+        kept = dataEnd - end;
+        memmove(buffer.data(), end, kept);
+    }
+    if (options.m_count) {
+        sink.append(prefix + std::to_string(matches) + "\n");
+    } else if (binaryMatched || encodingError) {
+        sink.flush();
+        smashErr() << "grep: " << name << ": binary file matches" << std::endl;
+    }
+    return true;
 }
 
-void DiskUsageCommand::execute() {                          //TODO: define no args du, and check logic
-
-    if (m_argc > 2) {
-        std::cerr << "smash error: du: too many arguments" << std::endl;
+void GrepCommand::execute() {
+    GrepOptions options = {"", false, false, false, false, false, false, false};
+    bool fixed = false, known = true, havePattern = false, endOfOptions = false;
+    std::vector<const char *> operands;
+    for (int i = 1; i < m_argc; ++i) {
+        const char *arg = m_argv[i];
+        if (endOfOptions || arg[0] != '-' || arg[1] == '\0') {
+            if (havePattern) {
+                operands.push_back(arg);
+            } else {
+                options.m_pattern = arg;
+                havePattern = true;
+            }
+        } else if (strcmp(arg, "--") == 0) {
+            endOfOptions = true;
+        } else {
+            const char *flags = arg + 1;
+            if (arg[1] == '-') {
+                flags = strcmp(arg, "--fixed-strings") == 0 ? "F" : strcmp(arg, "--invert-match") == 0 ? "v" :
+                        strcmp(arg, "--count") == 0 ? "c" : strcmp(arg, "--line-number") == 0 ? "n" :
+                        strcmp(arg, "--quiet") == 0 || strcmp(arg, "--silent") == 0 ? "q" : "?";
+            }
+            for (const char *flag = flags; *flag; ++flag) {
+                switch (*flag) {
+                    case 'F': fixed = true; break;
+                    case 'v': options.m_invert = true; break;
+                    case 'c': options.m_count = true; break;
+                    case 'n': options.m_lineNumbers = true; break;
+                    case 'q': options.m_quiet = true; break;
+                    default: known = false;
+                }
+            }
+        }
+    }
+    for (char c: options.m_pattern) known = known && (unsigned char) c < 0x80;
+    int encoding = known && fixed && havePattern ? grepEncoding() : -1;
+    std::vector<TextInput> inputs;
+    if (encoding == -1 || m_isBackgroundCommand || !SmallShell::getInstance().getTextBuiltins() ||
+        !openTextInputs(operands, inputs)) {
+        runTextTool(*this);
         return;
     }
-    std::string path;
-    if (m_argc == 2) {
-        path = m_argv[1];
-    } else {
-        char cwd[PATH_MAX];
-        if (!getcwd(cwd, sizeof(cwd))) {
-            printError("getcwd");
+    //grep refuses to read the file it is writing to
+    struct stat outStat, inStat;
+    int outFd = currentIo().m_outFd;
+    bool outIsFile = fstat(outFd, &outStat) == 0 && S_ISREG(outStat.st_mode);
+    for (const TextInput &input: inputs) {
+        if (outIsFile && fstat(input.m_fd, &inStat) == 0 && inStat.st_dev == outStat.st_dev &&
+            inStat.st_ino == outStat.st_ino) {
+            closeTextInputs(inputs);
+            runTextTool(*this);
             return;
         }
-        path = std::string(cwd);
     }
-    struct stat st;
-    if (syscall(SYS_lstat, path.c_str(), &st) == -1) {
-        std::cerr << "smash error: du: directory " << path << " does not exist" << std::endl;
-        return;
+    options.m_withNames = inputs.size() > 1;
+    options.m_utf8 = encoding == 0;
+    options.m_lineBuffered = isatty(outFd);
+    smashOut().flush();
+    TextSink sink(outFd);
+    for (const TextInput &input: inputs) {
+        const char *name = input.m_name == nullptr || strcmp(input.m_name, "-") == 0 ? "(standard input)"
+                                                                                      : input.m_name;
+        if (!grepInput(options, input.m_fd, name, sink) || sink.failed()) break;
     }
-    long totalSizeInKB = recursiveFolderSizeCalc(path, true);
-    std::cout << "Total disk usage: " << totalSizeInKB << " KB" << std::endl;
+    closeTextInputs(inputs);
 }
 
-void WhoAmICommand::execute() {
-    int UID = syscall(SYS_geteuid);
-    //now we need to connect the UID w/ the userName which is held in /etc/passwd
-    std::string passwdContent = readFile("/etc/passwd");
-    if (passwdContent == "") {
+void RedirectionCommand::execute() {
+    if (m_formatError != nullptr) {
+        smashErr() << "smash error: redirection: " << m_formatError << std::endl;
         return;
     }
-    //parsing by lines, userName:password:UID:GID:GECOS:homeDirectory:shell
-    std::istringstream passwdStream(passwdContent);
-    std::string line;
-    while (std::getline(passwdStream, line)) {
-        std::istringstream lineStream(line);
-        std::string userName, password, UIDstring, GID, GECOS, homePath, shell;
+    SmallShell &smash = SmallShell::getInstance();
+    LineArena &arena = LineArena::current();
+    LineArena::Mark mark = arena.mark();
+    const char *innerLine = m_commandPart;
+    if (m_isBackgroundCommand) {
+        size_t length = strlen(m_commandPart);
+        char *withSign = arena.copy(m_commandPart, length + 1);
+        withSign[length] = '&';
+        innerLine = withSign;
+    }
+    Command *inner = smash.CreateCommand(innerLine);
+    //external commands get the actions applied in their child, smash's own fds stay untouched.
+    //after and timeout hand them on to the process they create
+    if (dynamic_cast<ExternalCommand *>(inner) != nullptr || dynamic_cast<AfterCommand *>(inner) != nullptr ||
+        dynamic_cast<TimeoutCommand *>(inner) != nullptr) {
+        inner->setFdActions(m_fdActions);
+        inner->execute();
+        delete inner;
+        arena.rewind(mark);
+        return;
+    }
+    //everything else runs inside smash and writes through the thread's IoContext
+    IoContext io = currentIo();
+    std::vector<int> opened;
+    if (openFdActions(m_fdActions, io, opened)) {
+        ScopedIo scope(io.m_inFd, io.m_outFd, io.m_errFd);
+        inner->execute();
+    }
+    for (int fd: opened) close(fd);
+    delete inner;
+    arena.rewind(mark);
+}
 
-        std::getline(lineStream, userName, ':');
-        std::getline(lineStream, password, ':');
-        std::getline(lineStream, UIDstring, ':');
-        std::getline(lineStream, GID, ':');
-        std::getline(lineStream, GECOS, ':');
-        std::getline(lineStream, homePath, ':');
-        std::getline(lineStream, shell, ':');
+//a built-in (or composite) pipeline stage, run on a thread of smash with the pipe as its IoContext.
+//doneFd, an eventfd or -1, counts the stages that finished
+static void runPipeStage(Command *cmd, int inFd, int outFd, int errFd, int pipeFd, std::atomic<pid_t> *tid,
+                         int doneFd) {
+    tid->store(syscall(SYS_gettid));
+    {
+        ScopedIo scope(inFd, outFd, errFd);
+        cmd->execute();
+    }
+    tid->store(0);
+    close(pipeFd);
+    uint64_t one = 1;
+    if (doneFd != -1 && write(doneFd, &one, sizeof(one)) == -1) {}
+}
 
-        try {
-            if (std::stoi(UIDstring) == UID) {
-                std::cout << userName << " " << homePath << std::endl;
-                return;
-            }
-        } catch (...) {
-            return;
+//while a jobs -f stage runs, smash's thread serves the jobs: it drains the capture pipe the stage
+//waits on and wakes the stage on a ctrl-C. returns once count stages reported to doneFd
+static void serveStages(int doneFd, uint64_t count) {
+    SmallShell &smash = SmallShell::getInstance();
+    std::vector<int> events;
+    std::vector<struct pollfd> fds;
+    for (uint64_t finished = 0; finished < count;) {
+        events.clear();
+        smash.jobEventFds(events);
+        fds.assign(1, {doneFd, POLLIN, 0});
+        for (int fd: events) fds.push_back({fd, POLLIN, 0});
+        if (poll(fds.data(), fds.size(), -1) == -1) {
+            if (errno == EINTR) smash.getJobsList().notifyOutputs();
+            continue;
         }
+        uint64_t ended;
+        if (fds[0].revents != 0 && read(doneFd, &ended, sizeof(ended)) == sizeof(ended)) finished += ended;
+        smash.serviceJobs();
     }
 }
 
-void NetInfo::execute() {
-    if (m_argc < 2) {
-        std::cerr << "smash error: netinfo: interface not specified" << std::endl;
+//"pipesize trace on": every millisecond read the wchan of each stage task. a stage found
+//in pipe_write is waiting on a full pipe, in pipe_read on an empty one.
+static void samplePipeStages(std::atomic<pid_t> *tasks, bool *isThread, PipeStageStats *stats,
+                             std::atomic<bool> *done) {
+    struct timespec interval = {0, 1000000};
+    while (!done->load()) {
+        for (int i = 0; i < 2; ++i) {
+            pid_t task = tasks[i].load();
+            if (task <= 0) continue;
+            char path[64];
+            snprintf(path, sizeof(path), isThread[i] ? "/proc/self/task/%d/wchan" : "/proc/%d/wchan", task);
+            int fd = syscall(SYS_open, path, O_RDONLY | O_CLOEXEC);
+            if (fd == -1) continue;
+            char wchan[64] = {0};
+            long bytesRead = syscall(SYS_read, fd, wchan, sizeof(wchan) - 1);
+            close(fd);
+            if (bytesRead <= 0) continue;
+            stats[i].m_samples++;
+            if (strstr(wchan, "pipe") == nullptr) continue;
+            if (strstr(wchan, "write") != nullptr) stats[i].m_blockedFull++;
+            else if (strstr(wchan, "read") != nullptr) stats[i].m_blockedEmpty++;
+        }
+        syscall(SYS_nanosleep, &interval, nullptr);
+    }
+}
+
+void PipeCommand::execute() {
+    SmallShell &smash = SmallShell::getInstance();
+    LineArena &arena = LineArena::current();
+    LineArena::Mark mark = arena.mark();
+    Command *left = smash.CreateCommand(m_leftCmd);
+    Command *right = smash.CreateCommand(m_rightCmd);
+    int fd[2];
+    if (pipe2(fd, O_CLOEXEC) == -1) {
+        printError("pipe");
+        delete left;
+        delete right;
+        arena.rewind(mark);
         return;
     }
-    std::string iface = m_argv[1];
+    int pipeSize = m_pipeSize != 0 ? m_pipeSize : smash.getPipeSize();
+    if (pipeSize != 0 && fcntl(fd[1], F_SETPIPE_SZ, std::min(pipeSize, pipeMaxSize())) == -1) {
+        printError("fcntl");
+    }
+    smash.enterPipeline();
+    size_t statsSlot = smash.getPipeStats().size();
+    const IoContext &io = currentIo();
+    int leftOut = m_toStderr ? io.m_outFd : fd[1];
+    int leftErr = m_toStderr ? fd[1] : io.m_errFd;
+    ExternalCommand *leftExternal = dynamic_cast<ExternalCommand *>(left);
+    ExternalCommand *rightExternal = dynamic_cast<ExternalCommand *>(right);
+
+    //a writer that changes smash's own state (cd, alias, jobs, kill...) can't go on a stage
+    //thread: it runs here first, into a memfd the reader then gets instead of the pipe
+    bool leftDone = false;
+    if (!leftExternal && left->needsShellThread()) {
+        int outFd = memfd_create("stage", MFD_CLOEXEC);
+        if (outFd == -1) {
+            printError("memfd_create");
+        } else {
+            {
+                ScopedIo scope(io.m_inFd, m_toStderr ? io.m_outFd : outFd, m_toStderr ? outFd : io.m_errFd);
+                left->execute();
+            }
+            lseek(outFd, 0, SEEK_SET);
+            close(fd[0]);
+            close(fd[1]);
+            fd[0] = fd[1] = outFd;
+            leftDone = true;
+        }
+    }
 
+    //external stages fork first, before any stage thread exists
+    std::atomic<pid_t> tasks[2];
+    tasks[0] = tasks[1] = 0;
+    bool isThread[2] = {leftExternal == nullptr, rightExternal == nullptr};
+    if (leftExternal) {
+        ScopedIo scope(io.m_inFd, leftOut, leftErr);
+        tasks[0] = leftExternal->spawn();
+    }
+    if (rightExternal) {
+        ScopedIo scope(fd[0], io.m_outFd, io.m_errFd);
+        tasks[1] = rightExternal->spawn();
+    }
+    pid_t leftPid = tasks[0], rightPid = tasks[1];
+    if (leftExternal) close(fd[1]);
+    if (rightExternal) close(fd[0]);
+
+    //jobs -f as the writer: this thread has to stay free to drain its pipe, so a built-in reader
+    //gets a thread too, unless it must run here, and this thread serves the jobs meanwhile
+    bool serve = !leftExternal && !leftDone && smash.isShellThread() && left->followsJobOutput();
+    int doneFd = serve ? eventfd(0, EFD_CLOEXEC) : -1;
+    if (serve && doneFd == -1) {
+        printError("eventfd");
+        serve = false;
+    }
+    bool rightThreaded = serve && !rightExternal && !right->needsShellThread();
+    if (serve) takeCtrlC();     //one from before this pipeline
+
+    //stage threads block all signals: SIGPIPE becomes EPIPE and ctrl-C stays on smash's thread
+    sigset_t all, old;
+    sigfillset(&all);
+    PipeStageStats stats[2] = {{m_leftCmd, 0, 0, 0}, {m_rightCmd, 0, 0, 0}};
+    std::atomic<bool> done(false);
+    std::thread sampler;
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    if (smash.getPipeTrace()) {
+        sampler = std::thread(samplePipeStages, tasks, isThread, stats, &done);
+    }
+    //a built-in writer runs on its own thread so a full pipe can't block the reader
+    std::thread leftThread, rightThread;
+    if (!leftExternal && !leftDone) {
+        leftThread = std::thread(runPipeStage, left, io.m_inFd, leftOut, leftErr, fd[1], &tasks[0], doneFd);
+    }
+    if (rightThreaded) {
+        rightThread = std::thread(runPipeStage, right, fd[0], io.m_outFd, io.m_errFd, fd[0], &tasks[1], doneFd);
+    }
+    pthread_sigmask(SIG_SETMASK, &old, nullptr);
+    if (!rightExternal && !rightThreaded) {
+        runPipeStage(right, fd[0], io.m_outFd, io.m_errFd, fd[0], &tasks[1], -1);
+    }
+    if (serve) {
+        serveStages(doneFd, rightThreaded ? 2 : 1);
+        close(doneFd);
+        takeCtrlC();            //it stopped the stages
+    }
+    if (leftThread.joinable()) leftThread.join();
+    if (rightThread.joinable()) rightThread.join();
+
+    if (leftPid > 0) waitpid(leftPid, nullptr, 0);
+    if (rightPid > 0) waitpid(rightPid, nullptr, 0);
+    if (sampler.joinable()) {
+        done = true;
+        sampler.join();
+        //a nested pipeline stage already reported its own stages, the left one goes before them
+        std::vector<PipeStageStats> &allStats = smash.getPipeStats();
+        if (dynamic_cast<PipeCommand *>(right) == nullptr) allStats.push_back(stats[1]);
+        if (dynamic_cast<PipeCommand *>(left) == nullptr) {
+            allStats.insert(allStats.begin() + std::min(statsSlot, allStats.size()), stats[0]);
+        }
+    }
+    smash.leavePipeline();
+    delete left;
+    delete right;
+    arena.rewind(mark);
+}
 
-    if (if_nametoindex(iface.c_str()) == 0) {
-        std::cerr << "smash error: netinfo: interface "
-                  << iface << " does not exist" << std::endl;
+void PipeSizeCommand::execute() {
+    SmallShell &smash = SmallShell::getInstance();
+    if (m_argc == 1) {
+        smashOut() << "pipe size: " << smash.getPipeSize() << " (max " << pipeMaxSize() << ")" << '\n';
         return;
     }
-
-    std::string ip, mask;
-    if (!getIfaceAddr(iface, ip, mask)) {
-        std::cerr << "smash error: netinfo: failed to query interface" << std::endl;
+    if (strcmp(m_argv[1], "stats") == 0 && m_argc == 2) {
+        int stage = 1;
+        for (const PipeStageStats &stats: smash.getPipeStats()) {
+            double samples = stats.m_samples ? stats.m_samples : 1;
+            smashOut() << "[" << stage++ << "] " << stats.m_cmdLine << ": " << stats.m_samples << " samples, "
+                       << std::fixed << std::setprecision(1)
+                       << "blocked on full pipe " << stats.m_blockedFull * 100.0 / samples << "%, "
+                       << "on empty pipe " << stats.m_blockedEmpty * 100.0 / samples << "%" << '\n';
+        }
         return;
     }
-    std::string gw = getDefaultGateway(iface);
-    auto dns = getDnsServers();
-
-    /* ---------- הדפסה ---------- */
-    std::cout << "IP Address: " << ip << std::endl;
-    std::cout << "Subnet Mask: " << mask << std::endl;
-    std::cout << "Default Gateway: " << gw << std::endl;
-    std::cout << "DNS Servers: ";
-    for (size_t i = 0; i < dns.size(); ++i) {
-        std::cout << dns[i];
-        if (i + 1 < dns.size()) std::cout << ", ";
+    bool on = m_argc == 3 && strcmp(m_argv[2], "on") == 0;
+    if (strcmp(m_argv[1], "trace") == 0 && m_argc == 3 && (on || strcmp(m_argv[2], "off") == 0)) {
+        smash.setPipeTrace(on);
+        return;
+    }
+    int size;
+    if (m_argc != 2 || !parseSize(m_argv[1], size)) {
+        smashErr() << "smash error: pipesize: invalid arguments" << std::endl;
+        return;
+    }
+    if (size > pipeMaxSize()) {
+        smashErr() << "smash error: pipesize: capped to " << pipeMaxSize() << std::endl;
+        size = pipeMaxSize();
     }
-    std::cout << std::endl;
+    smash.setPipeSize(size);
 }
 
-#pragma endregion
+//one running task of parallel
+struct ParallelTask {
+    pid_t m_pid;
+    int m_pidFd;
+    int m_outFd;            //memfd collecting its stdout and stderr with -g, -1 otherwise
+    std::string m_cmdLine;
+    struct timespec m_startTime;
+};
 
-//--------------------EXTERNAL_COMMAND::EXECUTE()--------------------//
-void ExternalCommand::execute() {
+//waits for a task that exited (or, without a pidfd, until it does), prints its -g output and
+//records it for jobs -d
+static void reapParallelTask(ParallelTask &task, int outFd, int &failed) {
+    int status;
+    if (waitpid(task.m_pid, &status, 0) == -1) {
+        printError("waitpid");
+        status = 0;
+    }
+    if (task.m_outFd != -1) {
+        //-g: the whole output of one task at once
+        smashOut().flush();
+        lseek(task.m_outFd, 0, SEEK_SET);
+        transferFd(task.m_outFd, outFd);
+        close(task.m_outFd);
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) ++failed;
+    SmallShell &smash = SmallShell::getInstance();
+    if (smash.isShellThread()) {
+        smash.getJobsList().addFinishedJob(task.m_cmdLine, task.m_pid, 0, status, task.m_startTime);
+    }
+    if (task.m_pidFd != -1) close(task.m_pidFd);
+}
 
-    pid_t pid = fork();         //maybe need syscall
-    if (pid < 0) {
-        printError("fork");
+//command with every {} replaced by arg, or arg appended if there is no {}
+static std::string parallelTaskLine(const std::string &command, const std::string &arg) {
+    std::string line;
+    size_t pos = 0, found;
+    while ((found = command.find("{}", pos)) != std::string::npos) {
+        line.append(command, pos, found - pos).append(arg);
+        pos = found + 2;
+    }
+    if (pos == 0) return command + " " + arg;
+    return line.append(command, pos, std::string::npos);
+}
+
+void ParallelCommand::execute() {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t maxRunning = cpus > 0 ? cpus : 1;
+    bool group = false;
+    int i = 1;
+    for (; i < m_argc && m_argv[i][0] == '-' && strcmp(m_argv[i], ":::") != 0; ++i) {
+        if (strcmp(m_argv[i], "-g") == 0) {
+            group = true;
+            continue;
+        }
+        const char *count = nullptr;
+        if (strcmp(m_argv[i], "-j") == 0 && i + 1 < m_argc) count = m_argv[++i];
+        else if (strncmp(m_argv[i], "-j", 2) == 0) count = m_argv[i] + 2;
+        if (count == nullptr || atoi(count) <= 0) {
+            smashErr() << "smash error: parallel: invalid arguments" << std::endl;
+            return;
+        }
+        maxRunning = atoi(count);
+    }
+    std::string command;
+    for (; i < m_argc && strcmp(m_argv[i], ":::") != 0; ++i) command.append(command.empty() ? "" : " ").append(m_argv[i]);
+    if (command.empty()) {
+        smashErr() << "smash error: parallel: invalid arguments" << std::endl;
         return;
     }
-    if (pid == 0) {        // child process
-        setpgrp();                                         //new group ID
-        if (m_cmdLine.find('*') != std::string::npos ||
-            m_cmdLine.find('?') != std::string::npos) {   // complex external command
-            char *const args[] = {
-                    const_cast<char *>("/bin/bash"),
-                    const_cast<char *>("-c"),
-                    const_cast<char *>(m_cmdLine.c_str()),
-                    nullptr
-            };
-            execv("/bin/bash", args);
-        } else {                                            // simple external command
-            std::vector<char *> argv_cstr;
-            for (const auto &arg: m_argv) {
-                argv_cstr.push_back(const_cast<char *>(arg.c_str()));
+
+    //the arguments: after ":::", or one per line of stdin (a pipe: ls | parallel gzip)
+    const IoContext &io = currentIo();
+    std::vector<std::string> args;
+    bool fromStdin = i == m_argc;
+    if (!fromStdin) {
+        args.assign(m_argv + i + 1, m_argv + m_argc);
+    } else {
+        std::string input;
+        char buffer[KB4];
+        ssize_t got;
+        while ((got = read(io.m_inFd, buffer, sizeof(buffer))) != 0) {
+            if (got == -1 && errno == EINTR) continue;
+            if (got == -1) {
+                printError("read");
+                return;
             }
-            argv_cstr.push_back(nullptr);
-            execvp(argv_cstr[0], argv_cstr.data());
+            input.append(buffer, got);
         }
-
-        printError("exec");                      // exec dont return so if we got here its an error
-        syscall(SYS_exit, 1);
+        std::istringstream lines(input);
+        std::string line;
+        while (std::getline(lines, line)) if (!line.empty()) args.push_back(line);
     }
+
+    //children exiting wake poll() through their pidfds, the next task starts right away
+    LineArena &arena = LineArena::current();
+    int taskIn = fromStdin ? open("/dev/null", O_RDONLY | O_CLOEXEC) : io.m_inFd;
     SmallShell &smash = SmallShell::getInstance();
-    if (m_isBackgroundCommand) {
-        Command *command = smash.CreateCommand(getCmdLineFull().c_str());
-        smash.getJobsList().addJob(command, false, pid);
-        delete command;
-    } else {
-        smash.setFgProcPID(pid);
-        smash.setFgProcCmd(m_cmdLine);
-        if (syscall(SYS_wait4, pid, nullptr, 0, nullptr) == -1) printError("waitpid");
-        SmallShell::getInstance().clearFgJob();
+    std::vector<ParallelTask> running;
+    std::vector<struct pollfd> fds;
+    std::vector<int> events;
+    size_t next = 0;
+    int failed = 0;
+    bool interrupted = false;
+    takeCtrlC();
+    while ((next < args.size() && !interrupted) || !running.empty()) {
+        while (!interrupted && next < args.size() && running.size() < maxRunning) {
+            ParallelTask task;
+            task.m_cmdLine = parallelTaskLine(command, args[next++]);
+            task.m_outFd = group ? memfd_create("parallel", MFD_CLOEXEC) : -1;
+            clock_gettime(CLOCK_MONOTONIC, &task.m_startTime);
+            LineArena::Mark mark = arena.mark();
+            {
+                ScopedIo scoped(taskIn, group ? task.m_outFd : io.m_outFd, group ? task.m_outFd : io.m_errFd);
+                ExternalCommand *cmd = new ExternalCommand(task.m_cmdLine.c_str());
+                task.m_pid = cmd->spawn();
+                delete cmd;
+            }
+            arena.rewind(mark);
+            if (task.m_pid < 0) {
+                ++failed;
+                if (task.m_outFd != -1) close(task.m_outFd);
+                continue;
+            }
+            task.m_pidFd = (int) syscall(SYS_pidfd_open, task.m_pid, 0);
+            if (task.m_pidFd == -1) {
+                //poll() would skip it and never report it: this one is waited for right here
+                printError("pidfd_open");
+                reapParallelTask(task, io.m_outFd, failed);
+                continue;
+            }
+            running.push_back(task);
+        }
+        if (running.empty()) continue;
+
+        //on smash's thread the jobs are served meanwhile, as in waitForeground()
+        fds.clear();
+        for (const ParallelTask &task: running) fds.push_back({task.m_pidFd, POLLIN, 0});
+        events.clear();
+        if (smash.isShellThread()) smash.jobEventFds(events);
+        for (int fd: events) fds.push_back({fd, POLLIN, 0});
+        if (poll(fds.data(), fds.size(), -1) == -1) {
+            if (errno == EINTR && takeCtrlC() && !interrupted) {
+                //ctrl-C: no new tasks, stop the running ones (they have their own process groups)
+                interrupted = true;
+                for (const ParallelTask &task: running) kill(task.m_pid, SIGINT);
+            }
+            continue;
+        }
+        bool jobEvent = false;
+        for (size_t e = running.size(); e < fds.size(); ++e) jobEvent = jobEvent || fds[e].revents != 0;
+        for (size_t t = running.size(); t-- > 0;) {
+            if (fds[t].revents == 0) continue;
+            reapParallelTask(running[t], io.m_outFd, failed);
+            running.erase(running.begin() + t);
+        }
+        if (jobEvent) smash.serviceJobs();
+    }
+    if (fromStdin && taskIn != -1) close(taskIn);
+    if (failed > 0) {
+        smashErr() << "smash error: parallel: " << failed << " of " << next << " tasks failed" << std::endl;
     }
 }
-//--------------------SMASH CLASS--------------------//
-#pragma region SMASH CLASS
 
-SmallShell::SmallShell() {
+void AfterCommand::execute() {
+    int first = 1;
+    bool requireSuccess = m_argc > 1 && strcmp(m_argv[1], "-s") == 0;
+    if (requireSuccess) first++;
+    std::vector<int> after;
+    int arg = first;
+    for (; arg < m_argc && m_argv[arg][0] == '%'; arg++) {
+        const char *digits = m_argv[arg] + 1;
+        if (*digits == '\0' || strspn(digits, "0123456789") != strlen(digits)) break;
+        after.push_back(atoi(digits));
+    }
+    if (after.empty() || arg == m_argc) {
+        smashErr() << "smash error: after: invalid arguments" << std::endl;
+        return;
+    }
+    for (int jobId: after) {
+        if (m_jobsListRef.getJobById(jobId) == nullptr) {
+            smashErr() << "smash error: after: job-id " << jobId << " does not exist" << std::endl;
+            return;
+        }
+    }
+    std::string cmdLine = m_argv[arg];
+    for (int i = arg + 1; i < m_argc; i++) cmdLine.append(" ").append(m_argv[i]);
+    installChildHandler();      //dependents start when the prompt wakes on SIGCHLD
+    m_jobsListRef.addDependentJob(cmdLine, m_fdActions, after, requireSuccess);
 }
 
-SmallShell::~SmallShell() {
+//"TERM", "SIGTERM" or "15". 0 if unknown
+static int parseSignal(const char *name) {
+    static const struct {
+        const char *m_name;
+        int m_signal;
+    } SIGNALS[] = {{"HUP",  SIGHUP},  {"INT",  SIGINT},  {"QUIT", SIGQUIT}, {"KILL", SIGKILL},
+                   {"USR1", SIGUSR1}, {"USR2", SIGUSR2}, {"ALRM", SIGALRM}, {"TERM", SIGTERM},
+                   {"CONT", SIGCONT}, {"STOP", SIGSTOP}};
+    if (strspn(name, "0123456789") == strlen(name)) {
+        int signum = atoi(name);
+        return signum > 0 && signum < NSIG ? signum : 0;
+    }
+    if (strncmp(name, "SIG", 3) == 0) name += 3;
+    for (const auto &entry: SIGNALS) {
+        if (strcmp(entry.m_name, name) == 0) return entry.m_signal;
+    }
+    return 0;
 }
 
-Command *SmallShell::CreateCommand(const char *cmd_line) {
-    std::string cmd_s = _trim(string(cmd_line));
-    if (isAlias(cmd_s)) {
-        cmd_s = fixAliasCmdLine(cmd_s);
-    }
-    std::string firstWord = cmd_s.substr(0, cmd_s.find_first_of(" \n"));
-    firstWord = removeBackgroundSign(firstWord); //cuz we can have "kill&" != "kill"
-
-    //-------------------------------------------------------------------------------------//
-    if (firstWord == "alias") return new AliasCommand(cmd_s);
-    //-------------------------------------------------------------------------------------//
-    if (cmd_s.find('>') != std::string::npos) return new RedirectionCommand(cmd_s);
-    if (cmd_s.find('|') != std::string::npos) return new PipeCommand(cmd_s);
-    if (firstWord == "unalias") return new UnAliasCommand(cmd_s);
-    if (firstWord == "du") return new DiskUsageCommand(cmd_s);
-    if (firstWord == "whoami") return new WhoAmICommand(cmd_s);
-    if (firstWord == "netinfo") return new NetInfo(cmd_s);
-    //-------------------------------------------------------------------------------------//
-    if (firstWord == "chprompt") return new ChPromptCommand(cmd_s);
-    if (firstWord == "showpid") return new ShowPidCommand(cmd_s);
-    if (firstWord == "pwd") return new GetCurrDirCommand(cmd_s);
-    if (firstWord == "cd") return new ChangeDirCommand(cmd_s, this->getLastPWD());
-    if (firstWord == "jobs") return new JobsCommand(cmd_s, this->getJobsList());
-    if (firstWord == "fg") return new ForegroundCommand(cmd_s, this->getJobsList());
-    if (firstWord == "quit") return new QuitCommand(cmd_s, this->getJobsList());
-    if (firstWord == "kill") return new KillCommand(cmd_s, this->getJobsList());
-    if (firstWord == "unsetenv") return new UnSetEnvCommand(cmd_s);
-    if (firstWord == "watchproc") return new WatchProcCommand(cmd_s);
-    //-------------------------------------------------------------------------------------//
-    return new ExternalCommand(cmd_s);
+//"2.5", "30s", "5m", "1h", "1d". negative if invalid
+static double parseDuration(const char *text) {
+    char *end;
+    double seconds = strtod(text, &end);
+    if (end == text || seconds < 0) return -1;
+    if (*end != '\0' && end[1] != '\0') return -1;
+    switch (*end) {
+        case '\0':
+        case 's':
+            return seconds;
+        case 'm':
+            return seconds * 60;
+        case 'h':
+            return seconds * 3600;
+        case 'd':
+            return seconds * 86400;
+        default:
+            return -1;
+    }
 }
 
-void SmallShell::executeCommand(const char *cmd_line) {
-    Command *cmd = CreateCommand(cmd_line);
-    cmd->execute();
-    delete cmd;
-    //Please note that you must fork smash process for some commands (e.g., external commands....)
+void TimeoutCommand::execute() {
+    int signal = SIGTERM;
+    int arg = 1;
+    //-s SIG before or after the duration
+    if (arg + 1 < m_argc && strcmp(m_argv[arg], "-s") == 0) {
+        signal = parseSignal(m_argv[arg + 1]);
+        arg += 2;
+    }
+    double seconds = arg < m_argc ? parseDuration(m_argv[arg++]) : -1;
+    if (arg + 1 < m_argc && strcmp(m_argv[arg], "-s") == 0) {
+        signal = parseSignal(m_argv[arg + 1]);
+        arg += 2;
+    }
+    if (seconds <= 0 || signal == 0 || arg >= m_argc) {
+        smashErr() << "smash error: timeout: invalid arguments" << std::endl;
+        return;
+    }
+    std::string cmdLine = m_argv[arg];
+    for (int i = arg + 1; i < m_argc; i++) cmdLine.append(" ").append(m_argv[i]);
+    installChildHandler();
+    if (m_isBackgroundCommand) {
+        m_jobsListRef.addTimedJob(cmdLine, m_fdActions, seconds, signal);
+        return;
+    }
+
+    SmallShell &smash = SmallShell::getInstance();
+    LineArena &arena = LineArena::current();
+    LineArena::Mark mark = arena.mark();
+    ExternalCommand *cmd = new ExternalCommand(cmdLine.c_str());
+    cmd->setFdActions(m_fdActions);
+    pid_t pid = cmd->spawn();
+    delete cmd;
+    arena.rewind(mark);
+    if (pid < 0) return;
+    //not in the jobs list, the entry only carries the timer for waitForeground
+    JobsList::JobEntry timed(cmdLine, pid, 0, false);
+    timed.m_timeoutSignal = signal;
+    timed.m_timerFd = armTimer(seconds);
+    smash.setFgProcCmd(m_cmdLine);
+    smash.setFgProcPID(pid);
+    int status;
+    if (waitForeground(pid, &status, &timed) == -1) {
+        if (errno != ECHILD) printError("waitpid");
+    } else if (smash.isShellThread()) {     //as a pipeline stage it stays out of the job list
+        m_jobsListRef.addFinishedJob(cmdLine, pid, 0, status, timed.m_startTime, timed.m_timedOut);
+    }
+    if (timed.m_timerFd != -1) close(timed.m_timerFd);
+    smash.clearFgJob();
+}
+
+//one watch frame on a terminal: the header, then the output clipped to the window. only the
+//rows that differ from the previous frame are rewritten
+static void drawWatchFrame(int fd, const std::string &header, const std::string &output,
+                           std::vector<std::string> &shown, bool first) {
+    struct winsize size = {};
+    if (ioctl(fd, TIOCGWINSZ, &size) == -1 || size.ws_row == 0) {
+        size.ws_row = 24;
+        size.ws_col = 80;
+    }
+    std::vector<std::string> lines(1, header.substr(0, size.ws_col));
+    lines.push_back("");
+    for (size_t start = 0; start < output.size() && lines.size() < size.ws_row;) {
+        size_t end = output.find('\n', start);
+        if (end == std::string::npos) end = output.size();
+        lines.push_back(output.substr(start, std::min<size_t>(end - start, size.ws_col)));
+        start = end + 1;
+    }
+    std::string frame = first ? "\033[H\033[2J" : "";
+    if (first) shown.clear();
+    char move[32];
+    for (size_t row = 0; row < lines.size(); row++) {
+        if (row < shown.size() && shown[row] == lines[row]) continue;
+        snprintf(move, sizeof(move), "\033[%zu;1H", row + 1);
+        frame.append(move).append(lines[row]).append("\033[K");
+    }
+    if (frame.empty() && lines.size() == shown.size()) return;
+    snprintf(move, sizeof(move), "\033[%zu;1H", lines.size() + 1);
+    frame.append(move);
+    if (lines.size() < shown.size()) frame.append("\033[J");
+    shown.swap(lines);
+    smashOut() << frame << std::flush;
+}
+
+void WatchCommand::execute() {
+    double interval = 2;
+    long count = 0;         //0 = until ctrl-C
+    int arg = 1;
+    for (; arg + 1 < m_argc && m_argv[arg][0] == '-'; arg += 2) {
+        const char *value = m_argv[arg + 1];
+        if (strcmp(m_argv[arg], "-n") == 0) {
+            interval = parseDuration(value);
+        } else if (strcmp(m_argv[arg], "-c") == 0) {
+            count = strspn(value, "0123456789") == strlen(value) ? atol(value) : -1;
+        } else {
+            break;
+        }
+    }
+    if (interval <= 0 || count < 0 || arg >= m_argc) {
+        smashErr() << "smash error: watch: invalid arguments" << std::endl;
+        return;
+    }
+    //the raw rest of the line, so pipes and redirections belong to the watched command
+    const char *rest = m_cmdLine;
+    for (int i = 0; i < arg; i++) {
+        rest += strspn(rest, WHITESPACE.c_str());
+        rest += strcspn(rest, WHITESPACE.c_str());
+    }
+    rest += strspn(rest, WHITESPACE.c_str());
+
+    SmallShell &smash = SmallShell::getInstance();
+    IoContext io = currentIo();
+    int outFd = memfd_create("watch", MFD_CLOEXEC);
+    int timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (outFd == -1 || timerFd == -1) {
+        printError(outFd == -1 ? "memfd_create" : "timerfd_create");
+        if (outFd != -1) close(outFd);
+        if (timerFd != -1) close(timerFd);
+        return;
+    }
+    //ticks at start + k * interval on the kernel's clock, so the period does not drift with
+    //how long a run or a redraw takes
+    struct itimerspec spec = {};
+    spec.it_interval.tv_sec = (time_t) interval;
+    spec.it_interval.tv_nsec = (long) ((interval - (double) spec.it_interval.tv_sec) * 1e9);
+    if (spec.it_interval.tv_sec == 0 && spec.it_interval.tv_nsec == 0) spec.it_interval.tv_nsec = 1;
+    clock_gettime(CLOCK_MONOTONIC, &spec.it_value);
+    spec.it_value.tv_sec += spec.it_interval.tv_sec;
+    spec.it_value.tv_nsec += spec.it_interval.tv_nsec;
+    if (spec.it_value.tv_nsec >= 1000000000) {
+        spec.it_value.tv_sec++;
+        spec.it_value.tv_nsec -= 1000000000;
+    }
+    timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &spec, nullptr);
+
+    LineArena &arena = LineArena::current();
+    LineArena::Mark mark = arena.mark();
+    Command *cmd = smash.CreateCommand(rest);     //parsed once, executed on every tick
+    LineArena::Mark runMark = arena.mark();
+    bool terminal = isatty(io.m_outFd);
+    char header[256];
+    snprintf(header, sizeof(header), "Every %gs: %s", interval, rest);
+    std::vector<std::string> shown;
+    std::string output, previous;
+    std::vector<int> events;
+    std::vector<struct pollfd> fds;
+    takeCtrlC();
+    for (long run = 0; count == 0 || run < count; run++) {
+        if (run > 0) {
+            //sleep until the tick; jobs finishing or timing out meanwhile are still handled
+            bool tick = false, interrupted = false;
+            while (!tick && !interrupted) {
+                fds.assign(1, {timerFd, POLLIN, 0});
+                events.clear();
+                if (smash.isShellThread()) smash.jobEventFds(events);
+                for (int fd: events) fds.push_back({fd, POLLIN, 0});
+                if (poll(fds.data(), fds.size(), -1) == -1) {
+                    interrupted = errno == EINTR && takeCtrlC();
+                    continue;
+                }
+                tick = fds[0].revents != 0;
+                for (size_t i = 1; i < fds.size(); i++) {
+                    if (fds[i].revents) {
+                        smash.serviceJobs();
+                        break;
+                    }
+                }
+            }
+            if (interrupted) break;
+            uint64_t expirations;   //runs that took longer than the interval skip the missed ticks
+            if (read(timerFd, &expirations, sizeof(expirations)) == -1) printError("read");
+        }
+        //built-ins run in-process, externals are spawned as usual; output goes to the memfd
+        ftruncate(outFd, 0);
+        lseek(outFd, 0, SEEK_SET);
+        {
+            ScopedIo scoped(io.m_inFd, outFd, outFd);
+            cmd->execute();
+        }
+        arena.rewind(runMark);
+        bool interrupted = takeCtrlC();
+        off_t length = lseek(outFd, 0, SEEK_CUR);
+        output.resize(length);
+        if (length > 0 && pread(outFd, &output[0], length, 0) == -1) printError("read");
+        if (terminal) {
+            drawWatchFrame(io.m_outFd, header, output, shown, run == 0);
+        } else if (run == 0 || output != previous) {
+            //not a terminal: every distinct output once
+            smashOut() << output << std::flush;
+            previous.swap(output);
+        }
+        if (interrupted) break;
+    }
+    delete cmd;
+    arena.rewind(mark);
+    close(timerFd);
+    close(outFd);
+}
+
+void StatsCommand::execute() {
+    if (m_argc == 1) {
+        statsPrint(smashOut());
+    } else if (m_argc == 2 && strcmp(m_argv[1], "on") == 0) {
+        statsEnable(true);
+    } else if (m_argc == 2 && strcmp(m_argv[1], "off") == 0) {
+        statsEnable(false);
+    } else if (m_argc == 2 && strcmp(m_argv[1], "-r") == 0) {
+        statsReset();
+    } else {
+        smashErr() << "smash error: stats: invalid arguments" << std::endl;
+    }
+}
+
+//a write to a coproc that may have exited: EPIPE, not a SIGPIPE that would end smash
+static bool writeToCoproc(int fd, const char *data, size_t length) {
+    sigset_t pipeSignal, old;
+    sigemptyset(&pipeSignal);
+    sigaddset(&pipeSignal, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipeSignal, &old);
+    bool ok = writeAll(fd, data, length);
+    if (!ok && errno == EPIPE) {
+        struct timespec now = {0, 0};
+        sigtimedwait(&pipeSignal, nullptr, &now);      //the SIGPIPE is pending on this thread
+        errno = EPIPE;
+    }
+    pthread_sigmask(SIG_SETMASK, &old, nullptr);
+    return ok;
+}
+
+//the next line the coproc wrote, without its newline. false at the end of its output, or on
+//ctrl-C on smash's thread, which sets interrupted. smash's thread keeps serving jobs meanwhile
+static bool receiveLine(Coproc &coproc, std::string &line, bool &interrupted) {
+    SmallShell &smash = SmallShell::getInstance();
+    bool shellThread = smash.isShellThread();
+    std::vector<int> events;
+    std::vector<struct pollfd> fds;
+    char buffer[KB4];
+    size_t scanned = 0;
+    while (true) {
+        size_t newline = coproc.m_pending.find('\n', scanned);
+        if (newline != std::string::npos) {
+            line.assign(coproc.m_pending, 0, newline);
+            coproc.m_pending.erase(0, newline + 1);
+            return true;
+        }
+        scanned = coproc.m_pending.size();
+        fds.assign(1, {coproc.m_fromFd, POLLIN, 0});
+        events.clear();
+        if (shellThread) smash.jobEventFds(events);
+        for (int fd: events) fds.push_back({fd, POLLIN, 0});
+        if (poll(fds.data(), fds.size(), -1) == -1) {
+            if (errno == EINTR && shellThread && takeCtrlC()) {
+                interrupted = true;
+                return false;
+            }
+            continue;
+        }
+        for (size_t i = 1; i < fds.size(); i++) {
+            if (fds[i].revents) {
+                smash.serviceJobs();
+                break;
+            }
+        }
+        if (fds[0].revents == 0) continue;
+        long bytesRead = syscall(SYS_read, coproc.m_fromFd, buffer, sizeof(buffer));
+        if (bytesRead == -1 && errno == EINTR) continue;
+        if (bytesRead <= 0) {
+            if (coproc.m_pending.empty()) return false;
+            line.swap(coproc.m_pending);        //an unterminated last line
+            coproc.m_pending.clear();
+            return true;
+        }
+        coproc.m_pending.append(buffer, bytesRead);
+    }
+}
+
+static bool validCoprocName(const char *name) {
+    return *name != '\0' && strspn(name, "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_") ==
+                            strlen(name);
+}
+
+void CoprocCommand::execute() {
+    SmallShell &smash = SmallShell::getInstance();
+    if (m_argc == 1) {
+        for (const std::shared_ptr<Coproc> &coproc: smash.getCoprocs()) {
+            for (const auto &job: m_jobsListRef.getJobs()) {
+                if (job.second.m_jobPID != coproc->m_pid) continue;
+                smashOut() << coproc->m_name << ": [" << job.first << "] " << coproc->m_pid << " "
+                           << job.second.m_jobCommandString << '\n';
+            }
+        }
+        return;
+    }
+    if (m_argc < 3 || !validCoprocName(m_argv[1])) {
+        smashErr() << "smash error: coproc: invalid arguments" << std::endl;
+        return;
+    }
+    std::shared_ptr<Coproc> existing = smash.getCoproc(m_argv[1]);
+    if (existing != nullptr) {
+        for (const auto &job: m_jobsListRef.getJobs()) {
+            if (job.second.m_jobPID == existing->m_pid) {
+                smashErr() << "smash error: coproc: " << m_argv[1] << " already exists" << std::endl;
+                return;
+            }
+        }
+    }
+    std::string cmdLine = m_argv[2];
+    for (int i = 3; i < m_argc; i++) cmdLine.append(" ").append(m_argv[i]);
+    int toChild[2], fromChild[2];
+    if (pipe2(toChild, O_CLOEXEC) == -1) {
+        printError("pipe");
+        return;
+    }
+    if (pipe2(fromChild, O_CLOEXEC) == -1) {
+        printError("pipe");
+        close(toChild[0]);
+        close(toChild[1]);
+        return;
+    }
+    //always the program itself: a coproc of a built-in would have nobody to talk to
+    LineArena &arena = LineArena::current();
+    LineArena::Mark mark = arena.mark();
+    ExternalCommand *cmd = new ExternalCommand(cmdLine.c_str());
+    pid_t pid;
+    {
+        ScopedIo scope(toChild[0], fromChild[1], currentIo().m_errFd);
+        pid = cmd->spawn();
+    }
+    delete cmd;
+    arena.rewind(mark);
+    close(toChild[0]);
+    close(fromChild[1]);
+    if (pid < 0) {
+        close(toChild[1]);
+        close(fromChild[0]);
+        return;
+    }
+    m_jobsListRef.addJob(this, false, pid);
+    smash.addCoproc(std::make_shared<Coproc>(m_argv[1], pid, toChild[1], fromChild[0]));
+}
+
+void SendCommand::execute() {
+    if (m_argc < 2) {
+        smashErr() << "smash error: send: invalid arguments" << std::endl;
+        return;
+    }
+    std::shared_ptr<Coproc> coproc = SmallShell::getInstance().getCoproc(m_argv[1]);
+    if (coproc == nullptr) {
+        smashErr() << "smash error: send: coproc " << m_argv[1] << " does not exist" << std::endl;
+        return;
+    }
+    if (m_argc > 2) {
+        std::string request = m_argv[2];
+        for (int i = 3; i < m_argc; i++) request.append(" ").append(m_argv[i]);
+        request += '\n';
+        if (!writeToCoproc(coproc->m_toFd, request.data(), request.size())) {
+            smashErr() << "smash error: send: coproc " << m_argv[1] << " is not reading" << std::endl;
+        }
+        return;
+    }
+    //streaming: one request at a time, so neither side's pipe can fill up
+    std::vector<char> buffer(TEXT_BLOCK);
+    std::string request, reply;
+    bool interrupted = false, eof = false;
+    size_t kept = 0;
+    while (!eof) {
+        long bytesRead = readRetry(currentIo().m_inFd, buffer.data() + kept, buffer.size() - kept);
+        if (bytesRead < 0) return;
+        if (bytesRead == 0) {
+            eof = true;
+            if (kept == 0) break;
+            if (kept == buffer.size()) buffer.resize(buffer.size() + 1);
+            buffer[kept] = '\n';            //an unterminated last request
+            bytesRead = 1;
+        }
+        const char *begin = buffer.data(), *end = buffer.data() + kept + bytesRead;
+        for (const char *newline; (newline = static_cast<const char *>(memchr(begin, '\n', end - begin)));) {
+            if (!writeToCoproc(coproc->m_toFd, begin, newline + 1 - begin)) {
+                smashErr() << "smash error: send: coproc " << m_argv[1] << " is not reading" << std::endl;
+                return;
+            }
+            if (!receiveLine(*coproc, reply, interrupted)) {
+                if (!interrupted) {
+                    smashErr() << "smash error: send: coproc " << m_argv[1] << " closed its output" << std::endl;
+                }
+                return;
+            }
+            smashOut() << reply << '\n';
+            begin = newline + 1;
+        }
+        kept = end - begin;
+        memmove(buffer.data(), begin, kept);
+        if (kept == buffer.size()) buffer.resize(buffer.size() * 2);
+    }
+}
+
+void ReceiveCommand::execute() {
+    long count = m_argc == 3 && allDigits(m_argv[2]) ? atol(m_argv[2]) : m_argc == 2 ? 1 : 0;
+    if (count <= 0) {
+        smashErr() << "smash error: receive: invalid arguments" << std::endl;
+        return;
+    }
+    std::shared_ptr<Coproc> coproc = SmallShell::getInstance().getCoproc(m_argv[1]);
+    if (coproc == nullptr) {
+        smashErr() << "smash error: receive: coproc " << m_argv[1] << " does not exist" << std::endl;
+        return;
+    }
+    std::string line;
+    bool interrupted = false;
+    for (long i = 0; i < count; i++) {
+        if (!receiveLine(*coproc, line, interrupted)) {
+            if (!interrupted) {
+                smashErr() << "smash error: receive: coproc " << m_argv[1] << " closed its output" << std::endl;
+            }
+            return;
+        }
+        smashOut() << line << '\n';
+    }
+}
+
+void JobQueueCommand::execute() {
+    if (m_argc == 1) {
+        if (!m_jobsListRef.getQueueOn()) {
+            smashOut() << "job queue: off" << '\n';
+            return;
+        }
+        size_t running = m_jobsListRef.runningCount();
+        smashOut() << "job queue: on, limit " << m_jobsListRef.getJobLimit() << ", " << running << " running, "
+                   << m_jobsListRef.queuedCount() << " queued" << '\n';
+        return;
+    }
+    if (strcmp(m_argv[1], "on") == 0 && m_argc <= 3) {
+        long limit = m_argc == 3 ? atol(m_argv[2]) : sysconf(_SC_NPROCESSORS_ONLN);
+        if (limit <= 0) {
+            smashErr() << "smash error: jobq: invalid arguments" << std::endl;
+            return;
+        }
+        installChildHandler();
+        m_jobsListRef.setQueue(true, limit);
+        return;
+    }
+    if (strcmp(m_argv[1], "off") == 0 && m_argc == 2) {
+        m_jobsListRef.setQueue(false, m_jobsListRef.getJobLimit());     //starts everything queued
+        return;
+    }
+    bool first = strcmp(m_argv[1], "first") == 0, last = strcmp(m_argv[1], "last") == 0;
+    bool drop = strcmp(m_argv[1], "drop") == 0;
+    if (m_argc != 3 || !(first || last || drop) || strspn(m_argv[2], "0123456789") != strlen(m_argv[2])) {
+        smashErr() << "smash error: jobq: invalid arguments" << std::endl;
+        return;
+    }
+    int jobId = atoi(m_argv[2]);
+    if (!(drop ? m_jobsListRef.dropQueued(jobId) : m_jobsListRef.moveQueued(jobId, first))) {
+        smashErr() << "smash error: jobq: job-id " << jobId << " is not queued" << std::endl;
+    }
+}
+
+void HistoryCommand::execute() {
+    History &history = SmallShell::getInstance().getHistory();
+    std::vector<size_t> numbers;
+    if (m_argc >= 3 && strcmp(m_argv[1], "-s") == 0) {
+        //the text may have spaces, take it from the line
+        const char *text = strstr(m_cmdLine, "-s") + 2;
+        text += strspn(text, WHITESPACE.c_str());
+        history.search(text, strlen(text), numbers);
+    } else if (m_argc <= 2) {
+        size_t count = history.size();
+        size_t last = count;
+        if (m_argc == 2 && (strspn(m_argv[1], "0123456789") != strlen(m_argv[1]) ||
+                            (last = strtoul(m_argv[1], nullptr, 10)) == 0)) {
+            smashErr() << "smash error: history: invalid arguments" << std::endl;
+            return;
+        }
+        for (size_t n = count - std::min(last, count) + 1; n <= count; ++n) numbers.push_back(n);
+    } else {
+        smashErr() << "smash error: history: invalid arguments" << std::endl;
+        return;
+    }
+    for (size_t n: numbers) {
+        size_t length;
+        const char *text = history.entry(n, length);
+        smashOut() << std::setw(5) << n << "  ";
+        smashOut().write(text, length) << '\n';
+    }
+}
+
+void ParseCacheCommand::execute() {
+    ParseCache &cache = SmallShell::getInstance().getParseCache();
+    if (m_argc == 1) {
+        smashOut() << "parse cache: " << cache.size() << "/" << ParseCache::CAPACITY << " entries, "
+                   << cache.getHits() << " hits, " << cache.getMisses() << " misses" << '\n';
+        return;
+    }
+    if (m_argc != 2 || strcmp(m_argv[1], "clear") != 0) {
+        smashErr() << "smash error: parsecache: invalid arguments" << std::endl;
+        return;
+    }
+    cache.clear();
+}
+
+void DiskUsageCommand::execute() {                          //TODO: define no args du, and check logic
+
+    if (m_argc > 2) {
+        smashErr() << "smash error: du: too many arguments" << std::endl;
+        return;
+    }
+    std::string path;
+    if (m_argc == 2) {
+        path = m_argv[1];
+    } else {
+        char cwd[PATH_MAX];
+        if (!getcwd(cwd, sizeof(cwd))) {
+            printError("getcwd");
+            return;
+        }
+        path = std::string(cwd);
+    }
+    struct stat st;
+    if (syscall(SYS_lstat, path.c_str(), &st) == -1) {
+        smashErr() << "smash error: du: directory " << path << " does not exist" << std::endl;
+        return;
+    }
+    long totalSizeInKB = recursiveFolderSizeCalc(path, true);
+    smashOut() << "Total disk usage: " << totalSizeInKB << " KB" << '\n';
+}
+
+void WhoAmICommand::execute() {
+    int UID = syscall(SYS_geteuid);
+    //now we need to connect the UID w/ the userName which is held in /etc/passwd
+    std::string passwdContent = readFile("/etc/passwd");
+    if (passwdContent == "") {
+        return;
+    }
+    //parsing by lines, userName:password:UID:GID:GECOS:homeDirectory:shell
+    std::istringstream passwdStream(passwdContent);
+    std::string line;
+    while (std::getline(passwdStream, line)) {
+        std::istringstream lineStream(line);
+        std::string userName, password, UIDstring, GID, GECOS, homePath, shell;
+
+        std::getline(lineStream, userName, ':');
+        std::getline(lineStream, password, ':');
+        std::getline(lineStream, UIDstring, ':');
+        std::getline(lineStream, GID, ':');
+        std::getline(lineStream, GECOS, ':');
+        std::getline(lineStream, homePath, ':');
+        std::getline(lineStream, shell, ':');
+
+        try {
+            if (std::stoi(UIDstring) == UID) {
+                smashOut() << userName << " " << homePath << '\n';
+                return;
+            }
+        } catch (...) {
+            return;
+        }
+    }
+}
+
+void NetInfo::execute() {
+    if (m_argc < 2) {
+        smashErr() << "smash error: netinfo: interface not specified" << std::endl;
+        return;
+    }
+    std::string iface = m_argv[1];
+
+
+    if (if_nametoindex(iface.c_str()) == 0) {
+        smashErr() << "smash error: netinfo: interface "
+                  << iface << " does not exist" << std::endl;
+        return;
+    }
+
+    std::string ip, mask;
+    if (!getIfaceAddr(iface, ip, mask)) {
+        smashErr() << "smash error: netinfo: failed to query interface" << std::endl;
+        return;
+    }
+    std::string gw = getDefaultGateway(iface);
+    auto dns = getDnsServers();
+
+    /* ---------- הדפסה ---------- */
+    smashOut() << "IP Address: " << ip << '\n';
+    smashOut() << "Subnet Mask: " << mask << '\n';
+    smashOut() << "Default Gateway: " << gw << '\n';
+    smashOut() << "DNS Servers: ";
+    for (size_t i = 0; i < dns.size(); ++i) {
+        smashOut() << dns[i];
+        if (i + 1 < dns.size()) smashOut() << ", ";
+    }
+    smashOut() << '\n';
+}
+
+#pragma endregion
+
+//--------------------EXTERNAL_COMMAND::EXECUTE()--------------------//
+//the characters that make a line with * or ? need bash for more than the globbing
+#define BASH_SYNTAX "$`'\"\\;&|<>(){}~!#"
+
+//every word of argv through glob(3) the way bash would expand it: sorted matches, the word
+//itself when nothing matches. false if glob failed (out of memory), globbed is then empty
+static bool expandGlobs(char *const argv[], int argc, glob_t &globbed) {
+    memset(&globbed, 0, sizeof(globbed));
+    for (int i = 0; i < argc; i++) {
+        if (glob(argv[i], GLOB_NOCHECK | (i > 0 ? GLOB_APPEND : 0), nullptr, &globbed) != 0) {
+            globfree(&globbed);
+            return false;
+        }
+    }
+    return true;
+}
+
+//posix_spawn counterpart of the forked child below: same process group, io and signal mask.
+//the redirections are already opened into io. returns the pid, or -1 with errno set
+static pid_t spawnProcess(const char *path, bool search, char *const argv[], const IoContext &io) {
+    posix_spawnattr_t attr;
+    posix_spawn_file_actions_t fileActions;
+    posix_spawnattr_init(&attr);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+    posix_spawnattr_setpgroup(&attr, 0);
+    sigset_t none, handled;     //a pipeline stage thread spawns with every signal blocked
+    sigemptyset(&none);
+    posix_spawnattr_setsigmask(&attr, &none);
+    sigemptyset(&handled);
+    sigaddset(&handled, SIGINT);
+    sigaddset(&handled, SIGPIPE);
+    posix_spawnattr_setsigdefault(&attr, &handled);
+    posix_spawn_file_actions_init(&fileActions);
+    if (io.m_inFd != STDIN_FILENO) posix_spawn_file_actions_adddup2(&fileActions, io.m_inFd, STDIN_FILENO);
+    if (io.m_outFd != STDOUT_FILENO) posix_spawn_file_actions_adddup2(&fileActions, io.m_outFd, STDOUT_FILENO);
+    if (io.m_errFd != STDERR_FILENO) posix_spawn_file_actions_adddup2(&fileActions, io.m_errFd, STDERR_FILENO);
+    pid_t pid;
+    int error = search ? posix_spawnp(&pid, path, &fileActions, &attr, argv, __environ)
+                       : posix_spawn(&pid, path, &fileActions, &attr, argv, __environ);
+    posix_spawn_file_actions_destroy(&fileActions);
+    posix_spawnattr_destroy(&attr);
+    if (error != 0) {
+        errno = error;
+        return -1;
+    }
+    return pid;
+}
+
+pid_t ExternalCommand::spawn() {
+    //everything the child needs is ready before fork - a pipeline stage thread may hold the malloc lock
+    SmallShell &smash = SmallShell::getInstance();
+    bool isComplex = strpbrk(m_cmdLine, "*?") != nullptr;
+    char *bashArgv[] = {const_cast<char *>("/bin/bash"), const_cast<char *>("-c"),
+                        const_cast<char *>(m_cmdLine), nullptr};
+    char **argv = m_argv;
+    glob_t globbed;
+    bool isGlobbed = false;
+    if (isComplex && smash.getGlobMode() == GLOB_MODE_INTERNAL && strpbrk(m_cmdLine, BASH_SYNTAX) == nullptr &&
+        m_argc > 0 && expandGlobs(m_argv, m_argc, globbed)) {
+        argv = globbed.gl_pathv;
+        isGlobbed = true;
+        isComplex = false;
+    }
+    const char *execPath = isGlobbed ? nullptr : m_execPath;    //the command word itself may have been a pattern
+    const IoContext &io = currentIo();
+    smashOut().flush();
+    smashErr().flush();
+
+    if (smash.getLaunchMode() == LAUNCH_MODE_SPAWN) {
+        uint64_t spawned = statTime();
+        //the redirections are opened here, not by posix_spawn: a failed open is reported as one
+        //and does not make the PATH search below try the command again
+        IoContext childIo = io;
+        std::vector<int> opened;
+        pid_t pid = -1;
+        bool openedAll = openFdActions(m_fdActions, childIo, opened);
+        if (openedAll && isComplex) {
+            pid = spawnProcess("/bin/bash", false, bashArgv, childIo);
+        } else if (openedAll && m_argc > 0) {
+            if (execPath != nullptr) pid = spawnProcess(execPath, false, argv, childIo);
+            if (pid == -1) pid = spawnProcess(argv[0], true, argv, childIo);
+        }
+        for (int fd: opened) close(fd);
+        if (isGlobbed) globfree(&globbed);
+        if (pid == -1) {
+            if (openedAll) printError("exec");      //posix_spawn reports a failed exec of the child here
+            return -1;
+        }
+        statRecord(STAT_FORK, spawned);
+        return pid;
+    }
+
+    //with stats on, a close-on-exec pipe tells the parent when the exec happened
+    uint64_t forked = statTime();
+    int execPipe[2] = {-1, -1};
+    if (forked != 0 && pipe2(execPipe, O_CLOEXEC) == -1) forked = 0;
+    pid_t pid = fork();         //maybe need syscall
+    if (pid < 0) {
+        printError("fork");
+        if (execPipe[0] != -1) {
+            close(execPipe[0]);
+            close(execPipe[1]);
+        }
+        if (isGlobbed) globfree(&globbed);
+        return -1;
+    }
+    if (pid > 0 && forked != 0) {
+        statRecord(STAT_FORK, forked);
+        uint64_t execStart = statTime();
+        close(execPipe[1]);
+        char byte;
+        while (read(execPipe[0], &byte, 1) == -1 && errno == EINTR) {}    //EOF once exec closed it
+        close(execPipe[0]);
+        statRecord(STAT_EXEC, execStart);
+    }
+    if (pid == 0) {        // child process
+        setpgrp();                                         //new group ID
+        sigset_t none;     //a pipeline stage thread forks with every signal blocked
+        sigemptyset(&none);
+        sigprocmask(SIG_SETMASK, &none, nullptr);
+        if ((io.m_inFd != STDIN_FILENO && dup2(io.m_inFd, STDIN_FILENO) == -1) ||
+            (io.m_outFd != STDOUT_FILENO && dup2(io.m_outFd, STDOUT_FILENO) == -1) ||
+            (io.m_errFd != STDERR_FILENO && dup2(io.m_errFd, STDERR_FILENO) == -1)) {
+            syscall(SYS_exit, 1);
+        }
+        if (!applyFdActions(m_fdActions)) syscall(SYS_exit, 1);
+        if (isComplex) {   // complex external command
+            execv("/bin/bash", bashArgv);
+        } else if (m_argc > 0) {           // simple external command
+            if (execPath != nullptr) execv(execPath, argv);   //falls back to the search if it moved
+            execvp(argv[0], argv);
+        }
+
+        printError("exec");                      // exec dont return so if we got here its an error
+        syscall(SYS_exit, 1);
+    }
+    if (isGlobbed) globfree(&globbed);
+    return pid;
+}
+
+void ExternalCommand::setExecPath(const char *path) {
+    m_execPath = path;
+}
+
+void ExternalCommand::execute() {
+    if (m_argc == 0) return;    //empty line
+    if (m_isBackgroundCommand && SmallShell::getInstance().getJobsList().queueJob(this)) return;
+    //jobs -c: a background job writes into a pipe smash drains, not the terminal
+    int capture[2];
+    bool captured = m_isBackgroundCommand && SmallShell::getInstance().getJobsList().openCapture(capture);
+    pid_t pid;
+    if (captured) {
+        ScopedIo scope(currentIo().m_inFd, capture[1], capture[1]);
+        pid = spawn();
+        close(capture[1]);
+    } else {
+        pid = spawn();
+    }
+    if (pid < 0) {
+        if (captured) close(capture[0]);
+        return;
+    }
+    SmallShell &smash = SmallShell::getInstance();
+    if (m_isBackgroundCommand) {
+        smash.getJobsList().addJob(this, false, pid, captured ? capture[0] : -1);
+    } else {
+        smash.setFgProcCmd(m_cmdLine);
+        smash.setFgProcPID(pid);
+        if (waitForeground(pid, nullptr) == -1) printError("waitpid");
+        SmallShell::getInstance().clearFgJob();
+    }
+}
+//--------------------BUILTIN REGISTRY--------------------//
+#pragma region BUILTIN REGISTRY
+
+template<class T>
+static Command *makeCommand(const char *cmdLine, SmallShell &) {
+    return new T(cmdLine);
+}
+
+template<class T>
+static Command *makeJobsCommand(const char *cmdLine, SmallShell &smash) {
+    return new T(cmdLine, smash.getJobsList());
+}
+
+static Command *makeChangeDirCommand(const char *cmdLine, SmallShell &smash) {
+    return new ChangeDirCommand(cmdLine, smash.getLastPWD());
+}
+
+//to add a built-in: one line here. if the static_assert below fires, bump the seed.
+static constexpr BuiltinSpec BUILTINS[] = {
+        {"alias",      makeCommand<AliasCommand>,          BUILTIN_RAW_LINE | BUILTIN_SHELL_THREAD},
+        {"unalias",    makeCommand<UnAliasCommand>,        BUILTIN_SHELL_THREAD},
+        {"du",         makeCommand<DiskUsageCommand>,      BUILTIN_SPECIAL},
+        {"whoami",     makeCommand<WhoAmICommand>,         BUILTIN_SPECIAL},
+        {"netinfo",    makeCommand<NetInfo>,               BUILTIN_SPECIAL},
+        {"chprompt",   makeCommand<ChPromptCommand>,       BUILTIN_SHELL_THREAD},
+        {"showpid",    makeCommand<ShowPidCommand>,        0},
+        {"pwd",        makeCommand<GetCurrDirCommand>,     0},
+        {"cd",         makeChangeDirCommand,               BUILTIN_SHELL_THREAD},
+        {"jobs",       makeJobsCommand<JobsCommand>,       BUILTIN_SHELL_THREAD},
+        {"fg",         makeJobsCommand<ForegroundCommand>, BUILTIN_SHELL_THREAD},
+        {"quit",       makeJobsCommand<QuitCommand>,       BUILTIN_SHELL_THREAD},
+        {"kill",       makeJobsCommand<KillCommand>,       BUILTIN_SHELL_THREAD},
+        {"unsetenv",   makeCommand<UnSetEnvCommand>,       BUILTIN_SHELL_THREAD},
+        {"watchproc",  makeCommand<WatchProcCommand>,      0},
+        {"cat",        makeCommand<CatCommand>,            0},
+        {"tee",        makeCommand<TeeCommand>,            0},
+        {"pipesize",   makeCommand<PipeSizeCommand>,       BUILTIN_SHELL_THREAD},
+        {"parsecache", makeCommand<ParseCacheCommand>,     BUILTIN_SHELL_THREAD},
+        {"history",    makeCommand<HistoryCommand>,        0},
+        {"pushd",      makeCommand<PushDirCommand>,        BUILTIN_SHELL_THREAD},
+        {"popd",       makeCommand<PopDirCommand>,         BUILTIN_SHELL_THREAD},
+        {"dirs",       makeCommand<DirsCommand>,           0},
+        {"z",          makeCommand<JumpCommand>,           BUILTIN_SHELL_THREAD},
+        {"parallel",   makeCommand<ParallelCommand>,       0},
+        {"jobq",       makeJobsCommand<JobQueueCommand>,   BUILTIN_SHELL_THREAD},
+        {"after",      makeJobsCommand<AfterCommand>,      BUILTIN_SHELL_THREAD},
+        {"timeout",    makeJobsCommand<TimeoutCommand>,    0},
+        {"watch",      makeCommand<WatchCommand>,          BUILTIN_RAW_LINE},
+        {"stats",      makeCommand<StatsCommand>,          BUILTIN_SHELL_THREAD},
+        {"wc",         makeCommand<WordCountCommand>,      0},
+        {"head",       makeCommand<HeadCommand>,           0},
+        {"grep",       makeCommand<GrepCommand>,           0},
+        {"coproc",     makeJobsCommand<CoprocCommand>,     BUILTIN_SHELL_THREAD},
+        {"send",       makeCommand<SendCommand>,           0},
+        {"receive",    makeCommand<ReceiveCommand>,        0},
+};
+
+#define BUILTIN_COUNT ((int) (sizeof(BUILTINS) / sizeof(BUILTINS[0])))
+#define BUILTIN_SLOTS (128)
+#define BUILTIN_HASH_SEED (2166136276u)
+
+constexpr size_t constLength(const char *name) {
+    return *name ? 1 + constLength(name + 1) : 0;
+}
+
+//FNV-1a with a tuned offset basis, usable at compile time (C++11 constexpr)
+constexpr uint32_t builtinHash(const char *name, size_t length, uint32_t hash = BUILTIN_HASH_SEED) {
+    return length ? builtinHash(name + 1, length - 1, (hash ^ (uint8_t) *name) * 16777619u) : hash;
+}
+
+constexpr int builtinSlot(const char *name, size_t length) {
+    return (int) (builtinHash(name, length) & (BUILTIN_SLOTS - 1));
+}
+
+constexpr int builtinSlot(const char *name) {
+    return builtinSlot(name, constLength(name));
+}
+
+constexpr bool slotTaken(int slot, int before) {
+    return before > 0 && (builtinSlot(BUILTINS[before - 1].m_name) == slot || slotTaken(slot, before - 1));
+}
+
+constexpr bool isPerfectHash(int i = 0) {
+    return i == BUILTIN_COUNT || (!slotTaken(builtinSlot(BUILTINS[i].m_name), i) && isPerfectHash(i + 1));
+}
+
+static_assert(BUILTIN_COUNT < BUILTIN_SLOTS, "too many built-ins for BUILTIN_SLOTS");
+static_assert(isPerfectHash(), "built-in names collide, change BUILTIN_HASH_SEED");
+
+constexpr int slotOwner(int slot, int i = 0) {
+    return i == BUILTIN_COUNT ? -1 : builtinSlot(BUILTINS[i].m_name) == slot ? i : slotOwner(slot, i + 1);
+}
+
+#define SLOT_OWNERS_4(b) slotOwner(b), slotOwner((b) + 1), slotOwner((b) + 2), slotOwner((b) + 3)
+#define SLOT_OWNERS_16(b) SLOT_OWNERS_4(b), SLOT_OWNERS_4((b) + 4), SLOT_OWNERS_4((b) + 8), SLOT_OWNERS_4((b) + 12)
+#define SLOT_OWNERS_64(b) SLOT_OWNERS_16(b), SLOT_OWNERS_16((b) + 16), SLOT_OWNERS_16((b) + 32), SLOT_OWNERS_16((b) + 48)
+
+//slot -> index into BUILTINS, -1 for an empty slot
+static constexpr signed char BUILTIN_TABLE[BUILTIN_SLOTS] = {
+        SLOT_OWNERS_64(0), SLOT_OWNERS_64(64)
+};
+
+const BuiltinSpec *findBuiltin(const char *name, size_t length) {
+    int owner = BUILTIN_TABLE[builtinSlot(name, length)];
+    if (owner == -1 || strncmp(name, BUILTINS[owner].m_name, length) != 0 ||
+        BUILTINS[owner].m_name[length] != '\0') {
+        return nullptr;
+    }
+    return &BUILTINS[owner];
+}
+
+void builtinNames(std::vector<std::string> &names) {
+    for (const BuiltinSpec &spec: BUILTINS) names.push_back(spec.m_name);
+}
+
+#pragma endregion
+
+//--------------------SMASH CLASS--------------------//
+#pragma region SMASH CLASS
+
+SmallShell::SmallShell() : m_shellThread(std::this_thread::get_id()) {
+    const char *launch = getenv("SMASH_LAUNCH");
+    if (launch != nullptr && strcmp(launch, "spawn") == 0) m_launchMode = LAUNCH_MODE_SPAWN;
+    const char *globbing = getenv("SMASH_GLOB");
+    if (globbing != nullptr && strcmp(globbing, "internal") == 0) m_globMode = GLOB_MODE_INTERNAL;
+    const char *textBuiltins = getenv("SMASH_TEXT_BUILTINS");
+    if (textBuiltins != nullptr && strcmp(textBuiltins, "off") == 0) m_textBuiltins = false;
+    m_interactive = isatty(STDIN_FILENO);
+    if (m_statusPage.create(StatusPage::pathFor(getpid()))) {
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        m_statusPage.data().m_shellPID = getpid();
+        m_statusPage.data().m_shellStart = now.tv_sec * 1000000000ll + now.tv_nsec;
+        publishStatus();
+    }
+}
+
+SmallShell::~SmallShell() {
+}
+
+//PARSE CACHE
+
+//set by CreateCommand on a cache hit, taken by the Command constructor instead of tokenizing
+static thread_local const ParsedLine *t_adoptParsed = nullptr;
+
+static uint64_t lineHash(const char *line) {
+    uint64_t hash = 14695981039346656037ull;
+    for (; *line; ++line) hash = (hash ^ (uint8_t) *line) * 1099511628211ull;
+    return hash;
+}
+
+//the file execvp would run, or "" when that depends on more than PATH (relative entries, not found)
+static std::string resolveInPath(const char *name) {
+    const char *path = getenv("PATH");
+    if (path == nullptr || strchr(name, '/') != nullptr) return "";
+    for (const char *dir = path;; ++dir) {
+        const char *end = strchrnul(dir, ':');
+        if (*dir != '/') return "";
+        std::string candidate = std::string(dir, end) + "/" + name;
+        struct stat st;
+        if (stat(candidate.c_str(), &st) == 0 && S_ISREG(st.st_mode) && access(candidate.c_str(), X_OK) == 0) {
+            return candidate;
+        }
+        if (*end == '\0') return "";
+        dir = end;
+    }
+}
+
+const ParsedLine *ParseCache::find(const char *rawLine) {
+    const char *path = getenv("PATH");
+    if (m_path.compare(path ? path : "") != 0) {
+        clear();
+        m_path = path ? path : "";
+    }
+    auto iter = m_index.find(lineHash(rawLine));
+    if (iter == m_index.end() || iter->second->m_rawLine.compare(rawLine) != 0) {
+        ++m_misses;
+        return nullptr;
+    }
+    ++m_hits;
+    m_lru.splice(m_lru.begin(), m_lru, iter->second);
+    return &m_lru.front();
+}
+
+void ParseCache::insert(ParsedLine &&parsed) {
+    uint64_t hash = lineHash(parsed.m_rawLine.c_str());
+    auto iter = m_index.find(hash);
+    if (iter != m_index.end()) {
+        m_lru.erase(iter->second);   //same hash, other line
+    } else if (m_lru.size() >= CAPACITY) {
+        m_index.erase(lineHash(m_lru.back().m_rawLine.c_str()));
+        m_lru.pop_back();
+    }
+    m_lru.push_front(std::move(parsed));
+    m_index[hash] = m_lru.begin();
+}
+
+void ParseCache::clear() {
+    m_lru.clear();
+    m_index.clear();
+}
+
+size_t ParseCache::size() const {
+    return m_lru.size();
+}
+
+long ParseCache::getHits() const {
+    return m_hits;
+}
+
+long ParseCache::getMisses() const {
+    return m_misses;
+}
+
+Command *SmallShell::instantiate(const char *cmd_s, ParsedKind kind, const BuiltinSpec *builtin) {
+    switch (kind) {
+        case PARSED_BUILTIN: {
+            Command *cmd = builtin->m_factory(cmd_s, *this);
+            cmd->setShellThreadOnly(builtin->m_flags & BUILTIN_SHELL_THREAD);
+            return cmd;
+        }
+        case PARSED_REDIRECTION:
+            return new RedirectionCommand(cmd_s);
+        case PARSED_PIPE:
+            return new PipeCommand(cmd_s);
+        default:
+            return new ExternalCommand(cmd_s);
+    }
+}
+
+static_assert(STAT_BUILTIN == (int) PARSED_BUILTIN && STAT_REDIRECTION == (int) PARSED_REDIRECTION &&
+              STAT_PIPE == (int) PARSED_PIPE && STAT_EXTERNAL == (int) PARSED_EXTERNAL, "StatKind follows ParsedKind");
+
+Command *SmallShell::CreateCommand(const char *cmd_line) {
+    LineArena &arena = LineArena::current();
+    //pipeline stage threads parse too, the cache belongs to the shell thread
+    bool useCache = std::this_thread::get_id() == m_shellThread;
+    const ParsedLine *cached = useCache ? m_parseCache.find(cmd_line) : nullptr;
+    if (cached != nullptr) {
+        const char *cmd_s = arena.copy(cached->m_expandedLine.data(), cached->m_expandedLine.size());
+        t_adoptParsed = cached;
+        Command *cmd = instantiate(cmd_s, cached->m_kind, cached->m_builtin);
+        t_adoptParsed = nullptr;
+        if (!cached->m_execPath.empty()) {
+            static_cast<ExternalCommand *>(cmd)->setExecPath(
+                    arena.copy(cached->m_execPath.data(), cached->m_execPath.size()));
+        }
+        return cmd;
+    }
+
+    const char *start = cmd_line + strspn(cmd_line, WHITESPACE.c_str());
+    size_t length = strlen(start);
+    while (length > 0 && isspace((unsigned char) start[length - 1])) --length;
+    const char *cmd_s = arena.copy(start, length);
+    if (!m_compiledAliases.empty()) cmd_s = expandAlias(cmd_s);
+    size_t wordLength = strcspn(cmd_s, " \n");
+    if (wordLength > 0 && cmd_s[wordLength - 1] == '&') --wordLength; //cuz we can have "kill&" != "kill"
+
+    const BuiltinSpec *builtin = findBuiltin(cmd_s, wordLength);
+    ParsedKind kind;
+    if (builtin && (builtin->m_flags & BUILTIN_RAW_LINE)) kind = PARSED_BUILTIN;
+    else if (strpbrk(cmd_s, "<>") != nullptr) kind = PARSED_REDIRECTION;
+    else if (strchr(cmd_s, '|') != nullptr) kind = PARSED_PIPE;
+    else if (builtin) kind = PARSED_BUILTIN;
+    else kind = PARSED_EXTERNAL;
+    Command *cmd = instantiate(cmd_s, kind, builtin);
+    if (!useCache) return cmd;
+
+    ParsedLine parsed;
+    parsed.m_rawLine = cmd_line;
+    parsed.m_expandedLine = cmd_s;
+    parsed.m_kind = kind;
+    parsed.m_builtin = builtin;
+    parsed.m_cmdLine = cmd->getCmdLine();
+    parsed.m_argc = cmd->getArgc();
+    for (int i = 0; i < parsed.m_argc; ++i) {
+        parsed.m_tokens.append(cmd->getArgv()[i]);
+        parsed.m_tokens.push_back('\0');
+    }
+    parsed.m_isBackground = cmd->getIsBackgroundCommand();
+    if (kind == PARSED_EXTERNAL && parsed.m_argc > 0 && strpbrk(cmd_s, "*?") == nullptr) {
+        parsed.m_execPath = resolveInPath(cmd->getArgv()[0]);
+        if (!parsed.m_execPath.empty()) {
+            static_cast<ExternalCommand *>(cmd)->setExecPath(
+                    arena.copy(parsed.m_execPath.data(), parsed.m_execPath.size()));
+        }
+    }
+    m_parseCache.insert(std::move(parsed));
+    return cmd;
+}
+
+void SmallShell::executeCommand(const char *cmd_line) {
+    const char *start = cmd_line + strspn(cmd_line, WHITESPACE.c_str());
+    std::string expanded;
+    if (start[0] == '!' && start[1] != '\0' && !isspace((unsigned char) start[1])) {
+        if (!m_history.expand(start, expanded)) {
+            smashErr() << "smash error: " << std::string(start, strcspn(start, WHITESPACE.c_str()))
+                       << ": event not found" << std::endl;
+            return;
+        }
+        smashOut() << expanded << '\n';     //like bash, show what is run
+        start = cmd_line = expanded.c_str();
+    }
+    size_t length = strlen(start);
+    while (length > 0 && isspace((unsigned char) start[length - 1])) --length;
+    if (m_interactive) m_history.add(start, length);     //scripts and piped input stay out of the shared file
+
+    LineArena &arena = LineArena::current();
+    LineArena::Mark mark = arena.mark();
+    uint64_t started = statTime();
+    Command *cmd = CreateCommand(cmd_line);
+    StatKind kind = STAT_BUILTIN;
+    if (started != 0) {
+        if (dynamic_cast<RedirectionCommand *>(cmd) != nullptr) kind = STAT_REDIRECTION;
+        else if (dynamic_cast<PipeCommand *>(cmd) != nullptr) kind = STAT_PIPE;
+        else if (dynamic_cast<ExternalCommand *>(cmd) != nullptr) kind = STAT_EXTERNAL;
+        statRecord(STAT_PARSE, kind, started);
+        statSetKind(kind);
+    }
+    cmd->execute();
+    delete cmd;
+    arena.rewind(mark);
+    statRecord(STAT_TOTAL, kind, started);
+    m_commandCount++;
+    publishStatus();
+    //Please note that you must fork smash process for some commands (e.g., external commands....)
+}
+
+//GET-SET
+std::string SmallShell::getPrompt() {
+    return this->m_prompt;
+}
+
+void SmallShell::setPrompt(std::string value) {
+    this->m_prompt = value;
+}
+
+const std::string &SmallShell::getLastPWD() {
+    return this->m_lastPWD;
+}
+
+void SmallShell::setLastPWD(std::string value) {
+    this->m_lastPWD = value;
+}
+
+pid_t SmallShell::getFgProcPID() const {
+    return this->m_fgProcPID;
+}
+
+void SmallShell::setFgProcPID(pid_t pid) {
+    this->m_fgProcPID = pid;
+    publishStatus();
+}
+
+std::string SmallShell::getFgProcCmd() const {
+    return m_fgCmd;
+}
+
+void SmallShell::setFgProcCmd(const char *cmdLine) {
+    m_fgCmd = cmdLine;
+}
+
+void SmallShell::clearFgJob() {
+    m_fgProcPID = -1;
+    m_fgCmd = "";
+    publishStatus();
+}
+
+void SmallShell::dropFgProcPID() {
+    m_fgProcPID = -1;
+}
+
+JobsList &SmallShell::getJobsList() {
+    return m_jobsList;
+}
+
+int SmallShell::getPipeSize() const {
+    return m_pipeSize;
+}
+
+void SmallShell::setPipeSize(int size) {
+    m_pipeSize = size;
+}
+
+bool SmallShell::getPipeTrace() const {
+    return m_pipeTrace;
+}
+
+LaunchMode SmallShell::getLaunchMode() const {
+    return m_launchMode;
+}
+
+GlobMode SmallShell::getGlobMode() const {
+    return m_globMode;
+}
+
+bool SmallShell::getTextBuiltins() const {
+    return m_textBuiltins;
+}
+
+bool SmallShell::isInteractive() const {
+    return m_interactive;
+}
+
+void SmallShell::setPipeTrace(bool on) {
+    m_pipeTrace = on;
+}
+
+void SmallShell::enterPipeline() {
+    if (m_pipeDepth++ == 0 && m_pipeTrace) m_pipeStats.clear();
 }
 
-//GET-SET
-std::string SmallShell::getPrompt() {
-    return this->m_prompt;
+void SmallShell::leavePipeline() {
+    --m_pipeDepth;
 }
 
-void SmallShell::setPrompt(std::string value) {
-    this->m_prompt = value;
+std::vector<PipeStageStats> &SmallShell::getPipeStats() {
+    return m_pipeStats;
 }
 
-std::string SmallShell::getLastPWD() {
-    return this->m_lastPWD;
+ParseCache &SmallShell::getParseCache() {
+    return m_parseCache;
 }
 
-void SmallShell::setLastPWD(std::string value) {
-    this->m_lastPWD = value;
+History &SmallShell::getHistory() {
+    return m_history;
 }
 
-pid_t SmallShell::getFgProcPID() const {
-    return this->m_fgProcPID;
+DirIndex &SmallShell::getDirIndex() {
+    return m_dirIndex;
 }
 
-void SmallShell::setFgProcPID(pid_t pid) {
-    this->m_fgProcPID = pid;
+std::vector<std::string> &SmallShell::getDirStack() {
+    return m_dirStack;
 }
 
-std::string SmallShell::getFgProcCmd() const {
-    return m_fgCmd;
+void SmallShell::serviceJobs() {
+    drainChildEvents();
+    m_jobsList.drainOutputs();
+    m_jobsList.fireTimers();
+    m_jobsList.removeFinishedJobs();
+    m_jobsList.startQueuedJobs();
+    publishStatus();
 }
 
-void SmallShell::setFgProcCmd(std::string cmdLine) {
-    m_fgCmd = cmdLine;
+//how old the jobs' CPU times on the status page may get while the job table stays the same
+#define STATUS_CPU_INTERVAL_NS (1000000000ll)
+
+//CPU time of a running process in us, from /proc/<pid>/stat
+static void processCpuTime(pid_t pid, int64_t &user, int64_t &system) {
+    user = system = 0;
+    char path[32];
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return;
+    char buffer[1024];
+    ssize_t length = read(fd, buffer, sizeof(buffer) - 1);
+    close(fd);
+    unsigned long long utime, stime;
+    if (length <= 0 || !parseUtimeStime(std::string(buffer, length), utime, stime)) return;
+    static const long ticks = sysconf(_SC_CLK_TCK);
+    user = utime * 1000000 / ticks;
+    system = stime * 1000000 / ticks;
 }
 
-void SmallShell::clearFgJob() {
-    m_fgProcPID = -1;
-    m_fgCmd = "";
+static void copyCommand(char *to, const std::string &command) {
+    size_t length = std::min<size_t>(command.size(), STATUS_COMMAND_MAX);
+    memcpy(to, command.data(), length);
+    to[length] = '\0';
 }
 
-JobsList &SmallShell::getJobsList() {
-    return m_jobsList;
+void SmallShell::publishStatus() {
+    if (!m_statusPage.isOpen() || std::this_thread::get_id() != m_shellThread) return;
+    //sampled and formatted first, the write section is one copy
+    static StatusData next;
+    static int64_t cpuSampledNs = 0;        //CLOCK_MONOTONIC of next.m_cpuSampled
+    const StatusData &current = m_statusPage.data();
+    memcpy(next.m_magic, current.m_magic, sizeof(next.m_magic));
+    next.m_size = current.m_size;
+    next.m_shellPID = current.m_shellPID;
+    next.m_shellStart = current.m_shellStart;
+    struct timespec realNow, monotonicNow;
+    clock_gettime(CLOCK_REALTIME, &realNow);
+    clock_gettime(CLOCK_MONOTONIC, &monotonicNow);
+    int64_t realNs = realNow.tv_sec * 1000000000ll + realNow.tv_nsec;
+    int64_t monotonicNs = monotonicNow.tv_sec * 1000000000ll + monotonicNow.tv_nsec;
+    next.m_updated = realNs;
+    next.m_commands = m_commandCount;
+    next.m_jobsStarted = m_jobsList.getStartedCount();
+    next.m_jobsFinished = m_jobsList.getFinishedCount();
+    next.m_fgPID = m_fgProcPID;
+    copyCommand(next.m_fgCommand, m_fgProcPID == -1 ? "" : m_fgCmd);
+    const std::map<int, JobsList::JobEntry> &jobs = m_jobsList.getJobs();
+    bool changed = next.m_jobCount != jobs.size();
+    next.m_jobCount = jobs.size();
+    size_t slot = 0;
+    for (auto iter = jobs.begin(); iter != jobs.end() && slot < STATUS_MAX_JOBS; ++iter, ++slot) {
+        const JobsList::JobEntry &job = iter->second;
+        StatusJob &out = next.m_jobs[slot];
+        uint32_t state = job.m_isStopped ? STATUS_STOPPED : STATUS_RUNNING;
+        if (job.m_isWaiting) state = STATUS_WAITING;
+        else if (job.m_isQueued) state = STATUS_QUEUED;
+        changed = changed || out.m_jobID != iter->first || out.m_pid != job.m_jobPID || out.m_state != state;
+        out.m_jobID = iter->first;
+        out.m_pid = job.m_jobPID;
+        out.m_state = state;
+        int64_t started = job.m_startTime.tv_sec * 1000000000ll + job.m_startTime.tv_nsec;
+        out.m_startTime = realNs - (monotonicNs - started);
+        copyCommand(out.m_command, job.m_jobCommandString);
+    }
+    //this runs several times per command: /proc is read for every job only once a job came, went
+    //or changed state, or the last sample got old. otherwise the previous times and m_cpuSampled stay
+    if (changed || monotonicNs - cpuSampledNs >= STATUS_CPU_INTERVAL_NS) {
+        cpuSampledNs = monotonicNs;
+        next.m_cpuSampled = realNs;
+        slot = 0;
+        for (auto iter = jobs.begin(); iter != jobs.end() && slot < STATUS_MAX_JOBS; ++iter, ++slot) {
+            StatusJob &out = next.m_jobs[slot];
+            if (iter->second.m_isQueued) out.m_userTime = out.m_systemTime = 0;
+            else processCpuTime(out.m_pid, out.m_userTime, out.m_systemTime);
+        }
+    }
+    //the slots past m_jobCount are left as they were, readers ignore them
+    size_t used = offsetof(StatusData, m_jobs) + slot * sizeof(StatusJob);
+    m_statusPage.beginWrite();
+    memcpy(&m_statusPage.data(), &next, used);
+    m_statusPage.endWrite();
+}
+
+void SmallShell::removeStatusPage() {
+    m_statusPage.remove();
+}
+
+void SmallShell::jobEventFds(std::vector<int> &fds) const {
+    if (childEventFd() != -1) fds.push_back(childEventFd());
+    m_jobsList.timerFds(fds);
+    m_jobsList.outputFds(fds);
+}
+
+bool SmallShell::aliasesChanged() {
+    std::unordered_map<std::string, std::string> compiled;
+    for (const auto &alias: m_aliasMap) {
+        std::string expansion;
+        if (!compileAlias(alias.first, expansion)) return false;
+        compiled[alias.first] = expansion;
+    }
+    m_compiledAliases.swap(compiled);
+    m_parseCache.clear();
+    return true;
+}
+
+bool SmallShell::isShellThread() const {
+    return std::this_thread::get_id() == m_shellThread;
+}
+
+//COPROCS
+
+Coproc::Coproc(const std::string &name, pid_t pid, int toFd, int fromFd) : m_name(name), m_pid(pid),
+                                                                           m_toFd(toFd), m_fromFd(fromFd) {}
+
+Coproc::~Coproc() {
+    close(m_toFd);
+    close(m_fromFd);
+}
+
+void SmallShell::pruneCoprocs() {
+    if (!isShellThread()) return;
+    m_jobsList.removeFinishedJobs();
+    for (auto iter = m_coprocs.begin(); iter != m_coprocs.end();) {
+        bool running = false;
+        for (const auto &job: m_jobsList.getJobs()) running = running || job.second.m_jobPID == iter->second->m_pid;
+        struct pollfd output = {iter->second->m_fromFd, POLLIN, 0};
+        bool unread = !iter->second->m_pending.empty() || (poll(&output, 1, 0) == 1 && (output.revents & POLLIN));
+        if (running || unread) ++iter;
+        else iter = m_coprocs.erase(iter);
+    }
+}
+
+std::shared_ptr<Coproc> SmallShell::getCoproc(const std::string &name) {
+    std::lock_guard<std::mutex> lock(m_coprocLock);
+    pruneCoprocs();
+    auto found = m_coprocs.find(name);
+    return found == m_coprocs.end() ? nullptr : found->second;
+}
+
+void SmallShell::addCoproc(const std::shared_ptr<Coproc> &coproc) {
+    std::lock_guard<std::mutex> lock(m_coprocLock);
+    m_coprocs[coproc->m_name] = coproc;
+}
+
+std::vector<std::shared_ptr<Coproc>> SmallShell::getCoprocs() {
+    std::lock_guard<std::mutex> lock(m_coprocLock);
+    pruneCoprocs();
+    std::vector<std::shared_ptr<Coproc>> coprocs;
+    for (const auto &entry: m_coprocs) coprocs.push_back(entry.second);
+    return coprocs;
 }
 
 //ALIAS HANDLING
-bool SmallShell::isAlias(std::string cmd_line) {
-    std::string firstWord = cmd_line.substr(0, cmd_line.find_first_of(" \n"));
-    firstWord = removeBackgroundSign(firstWord); //cuz we can have "kill&" != "kill"
-    auto iter = m_aliasMap.find(firstWord);
-    if (iter != m_aliasMap.end()) {
-        return true;
+
+//the first word of a value, without a glued '&' ("kill&" is "kill")
+static size_t aliasWordLength(const std::string &value) {
+    size_t length = value.find_first_of(" \n");
+    if (length == std::string::npos) length = value.size();
+    if (length > 0 && value[length - 1] == '&') --length;
+    return length;
+}
+
+bool SmallShell::compileAlias(const std::string &name, std::string &expansion) const {
+    expansion = m_aliasMap.at(name);
+    std::vector<std::string> chain(1, name);
+    while (true) {
+        std::string word = expansion.substr(0, aliasWordLength(expansion));
+        auto next = m_aliasMap.find(word);
+        if (next == m_aliasMap.end() || word == chain.back()) {
+            return true;    //not an alias, or one that starts with its own name (alias ls='ls -l')
+        }
+        if (std::find(chain.begin(), chain.end(), word) != chain.end()) return false;
+        chain.push_back(word);
+        expansion = next->second + expansion.substr(word.size());
     }
-    return false;
 }
 
-std::string SmallShell::fixAliasCmdLine(std::string cmd_line) {
-    string cmd_s;
-    std::string firstWord = cmd_line.substr(0, cmd_line.find_first_of(" \n"));
-    firstWord = removeBackgroundSign(firstWord);
-    std::string rest = cmd_line.substr(cmd_line.find_first_of(" \n") + 1, cmd_line.length());
-    firstWord = m_aliasMap.find(firstWord)->second;
-    return firstWord + rest;
-    //TODO: check & rules
+const char *SmallShell::expandAlias(const char *cmd_s) {
+    size_t wordLength = strcspn(cmd_s, " \n");
+    if (wordLength > 0 && cmd_s[wordLength - 1] == '&') --wordLength; //cuz we can have "kill&" != "kill"
+    //per thread: pipeline stages parse their own lines while smash's thread parses. reused, so
+    //a lookup allocates only for a word longer than any before on this thread
+    static thread_local std::string key;
+    key.assign(cmd_s, wordLength);
+    auto iter = m_compiledAliases.find(key);
+    if (iter == m_compiledAliases.end()) return cmd_s;
+    //splice: the compiled value, then everything after the alias word as typed ('&' and args)
+    const std::string &expansion = iter->second;
+    size_t restLength = strlen(cmd_s + wordLength);
+    char *line = (char *) LineArena::current().allocate(expansion.size() + restLength + 1);
+    memcpy(line, expansion.data(), expansion.size());
+    memcpy(line + expansion.size(), cmd_s + wordLength, restLength + 1);
+    return line;
 }
 
 #pragma endregion
@@ -1074,46 +3902,79 @@ int JobsList::calcNewID() {
 void JobsList::removeFinishedJobs() {
     auto iter = m_jobs.begin();
     while (iter != m_jobs.end()) {
+        //queued: no process yet. the fg job is reaped by fg itself
+        if (iter->second.m_isQueued || iter->second.m_jobPID == SmallShell::getInstance().getFgProcPID()) {
+            ++iter;
+            continue;
+        }
         int status; //might need to use in the future, currently unsure if status is needed
+        uint64_t reapStart = statTime();
         long result = syscall(SYS_wait4, iter->second.m_jobPID, &status, WNOHANG, NULL);
+        if (result > 0) statRecord(STAT_REAP, STAT_EXTERNAL, reapStart);
 
         if (result == -1) {
             if (errno == ECHILD) {
+                jobEnded(iter->second, false);
                 iter = m_jobs.erase(iter);
                 continue;
             }
             printError("waitpid");
         }
-        if (result <= 0) ++iter;
-        else iter = m_jobs.erase(iter); //TODO: make sure i dont want to remove failed jobs where waitpid() returned -1
+        if (result <= 0) {
+            ++iter;
+            continue;
+        }
+        addFinishedJob(iter->second.m_jobCommandString, iter->second.m_jobPID, iter->first, status,
+                       iter->second.m_startTime, iter->second.m_timedOut);
+        jobEnded(iter->second, WIFEXITED(status) && WEXITSTATUS(status) == 0);
+        iter = m_jobs.erase(iter); //TODO: make sure i dont want to remove failed jobs where waitpid() returned -1
     }
+    releaseDependents();
 }
 
-void JobsList::addJob(Command *cmd, bool isStopped, pid_t jobPID) {
+void JobsList::addJob(Command *cmd, bool isStopped, pid_t jobPID, int outputFd) {
     this->removeFinishedJobs();
     int uniqueID = calcNewID();
     std::string cmdLine = cmd->getCmdLineFull();
     JobEntry newJob(cmdLine, jobPID, uniqueID, isStopped);
+    newJob.m_serial = m_nextSerial++;
+    if (jobPID > 0) newJob.m_pidFd = (int) syscall(SYS_pidfd_open, jobPID, 0);     //not reaped yet: still ours
     m_jobs.insert({uniqueID, newJob});
+    m_startedCount++;
+    if (outputFd != -1) addOutput(uniqueID, newJob.m_serial, outputFd);
 }
 
 void JobsList::printJobsList() {
     this->removeFinishedJobs();
     auto iter = m_jobs.begin();
     while (iter != m_jobs.end()) {
-        std::cout << "[" << iter->first << "] " << iter->second.m_jobCommandString << std::endl;
+        const JobEntry &job = iter->second;
+        smashOut() << "[" << iter->first << "] " << job.m_jobCommandString;
+        if (job.m_isWaiting) {
+            smashOut() << " (after";
+            for (const auto &prerequisite: job.m_after) smashOut() << " %" << prerequisite.second;
+            smashOut() << (job.m_afterSuccess ? " succeed)" : ")");
+        } else if (job.m_isQueued) {
+            smashOut() << " (queued)";
+        }
+        smashOut() << '\n';
         ++iter;
     }
 }
 
 void JobsList::killAllJobs() {
     this->removeFinishedJobs();
-    std::cout << "smash: sending SIGKILL signal to " << m_jobs.size() << " jobs:" << std::endl;
+    //queued and waiting jobs have nothing to kill
+    for (auto iter = m_jobs.begin(); iter != m_jobs.end();) {
+        if (iter->second.m_isQueued) iter = m_jobs.erase(iter);
+        else ++iter;
+    }
+    m_queue.clear();
+    smashOut() << "smash: sending SIGKILL signal to " << m_jobs.size() << " jobs:" << '\n';
     auto iter = m_jobs.begin();
     while (iter != m_jobs.end()) {
-        std::cout << iter->second.m_jobPID << ": " << iter->second.m_jobCommandString << std::endl;
-        int result = syscall(SYS_kill, iter->second.m_jobPID, SIGKILL);
-        if (result == -1) printError("kill");
+        smashOut() << iter->second.m_jobPID << ": " << iter->second.m_jobCommandString << '\n';
+        if (!signalJob(iter->second, SIGKILL)) printError("kill");
         ++iter; //jobs will be removed anyway on next call for any method of JobsList
     }
     this->removeFinishedJobs();// not sure if needed
@@ -1127,12 +3988,16 @@ JobsList::JobEntry *JobsList::getJobById(int jobId) {
     return &iter->second;
 }
 
-void JobsList::removeJobById(int jobId) {
+void JobsList::removeJobById(int jobId, bool succeeded) {
     this->removeFinishedJobs();
     auto iter = m_jobs.find(jobId);
     if (iter == m_jobs.end()) return;
+    auto queued = std::find(m_queue.begin(), m_queue.end(), jobId);
+    if (queued != m_queue.end()) m_queue.erase(queued);
 
+    jobEnded(iter->second, succeeded);
     m_jobs.erase(iter);
+    releaseDependents();
 }
 
 JobsList::JobEntry *JobsList::getLastJob(int *lastJobId) {
@@ -1143,6 +4008,253 @@ JobsList::JobEntry *JobsList::getLastJob(int *lastJobId) {
     return &last->second;
 }
 
+void JobsList::addFinishedJob(const std::string &cmdLine, pid_t pid, int jobId, int status,
+                              const struct timespec &startTime, bool timedOut) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double seconds = (now.tv_sec - startTime.tv_sec) + (now.tv_nsec - startTime.tv_nsec) / 1e9;
+    m_finished.push_back({cmdLine, pid, jobId, status, seconds, timedOut});
+    if (pid != -1) m_finishedCount++;
+    if (m_finished.size() > FINISHED_JOBS_KEPT) m_finished.pop_front();
+}
+
+void JobsList::setQueue(bool on, size_t limit) {
+    m_queueOn = on;
+    m_jobLimit = limit;
+    startQueuedJobs();
+}
+
+bool JobsList::getQueueOn() const {
+    return m_queueOn;
+}
+
+size_t JobsList::getJobLimit() const {
+    return m_jobLimit;
+}
+
+size_t JobsList::runningCount() {
+    this->removeFinishedJobs();
+    size_t running = 0;
+    for (const auto &job: m_jobs) running += !job.second.m_isQueued && !job.second.m_isStopped;
+    return running;
+}
+
+size_t JobsList::queuedCount() const {
+    return m_queue.size();
+}
+
+bool JobsList::queueJob(Command *cmd) {
+    if (!m_queueOn || runningCount() < m_jobLimit) return false;
+    int uniqueID = calcNewID();
+    JobEntry newJob(cmd->getCmdLineFull(), -1, uniqueID, false);
+    newJob.m_serial = m_nextSerial++;
+    newJob.m_isQueued = true;
+    newJob.m_fdActions = cmd->getFdActions();
+    m_jobs.insert({uniqueID, newJob});
+    m_queue.push_back(uniqueID);
+    return true;
+}
+
+//forks a queued job with smash's own stdin/stdout/stderr, like any background job
+bool JobsList::launchJob(JobEntry &job) {
+    std::string cmdLine = job.m_jobCommandString;
+    if (!cmdLine.empty() && cmdLine.back() == '&') cmdLine.pop_back();
+    LineArena &arena = LineArena::current();
+    LineArena::Mark mark = arena.mark();
+    int capture[2];
+    bool captured = openCapture(capture);
+    pid_t pid;
+    {
+        ScopedIo scoped(STDIN_FILENO, captured ? capture[1] : STDOUT_FILENO, captured ? capture[1] : STDERR_FILENO);
+        ExternalCommand *cmd = new ExternalCommand(cmdLine.c_str());
+        cmd->setFdActions(job.m_fdActions);
+        pid = cmd->spawn();
+        delete cmd;
+    }
+    arena.rewind(mark);
+    if (captured) close(capture[1]);
+    if (pid < 0) {
+        if (captured) close(capture[0]);
+        return false;
+    }
+    if (captured) addOutput(job.m_jobID, job.m_serial, capture[0]);
+    job.m_jobPID = pid;
+    job.m_pidFd = (int) syscall(SYS_pidfd_open, pid, 0);
+    job.m_isQueued = false;
+    job.m_fdActions.clear();
+    clock_gettime(CLOCK_MONOTONIC, &job.m_startTime);
+    if (job.m_timeout > 0) job.m_timerFd = armTimer(job.m_timeout);
+    m_startedCount++;
+    return true;
+}
+
+void JobsList::startQueuedJobs() {
+    while (!m_queue.empty() && (!m_queueOn || runningCount() < m_jobLimit)) {
+        startJob(m_queue.front());
+    }
+}
+
+bool JobsList::startJob(int jobId) {
+    auto queued = std::find(m_queue.begin(), m_queue.end(), jobId);
+    if (queued == m_queue.end()) return false;
+    m_queue.erase(queued);
+    JobEntry &job = m_jobs.at(jobId);
+    if (launchJob(job)) return true;
+    jobEnded(job, false);       //spawn printed why
+    m_jobs.erase(jobId);
+    releaseDependents();
+    return false;
+}
+
+bool JobsList::moveQueued(int jobId, bool toFront) {
+    auto queued = std::find(m_queue.begin(), m_queue.end(), jobId);
+    if (queued == m_queue.end()) return false;
+    m_queue.erase(queued);
+    if (toFront) m_queue.push_front(jobId);
+    else m_queue.push_back(jobId);
+    return true;
+}
+
+bool JobsList::dropQueued(int jobId) {
+    auto iter = m_jobs.find(jobId);
+    if (iter == m_jobs.end() || !iter->second.m_isQueued) return false;
+    removeJobById(jobId);
+    return true;
+}
+
+int JobsList::addDependentJob(const std::string &cmdLine, const std::vector<FdAction> &fdActions,
+                              const std::vector<int> &after, bool requireSuccess) {
+    this->removeFinishedJobs();
+    int uniqueID = calcNewID();
+    JobEntry newJob(cmdLine, -1, uniqueID, false);
+    newJob.m_serial = m_nextSerial++;
+    newJob.m_isQueued = true;
+    newJob.m_isWaiting = true;
+    newJob.m_afterSuccess = requireSuccess;
+    newJob.m_fdActions = fdActions;
+    for (int jobId: after) {
+        const JobEntry &prerequisite = m_jobs.at(jobId);
+        newJob.m_after.emplace_back(prerequisite.m_serial, jobId);
+    }
+    m_jobs.insert({uniqueID, newJob});
+    return uniqueID;
+}
+
+void JobsList::addTimedJob(const std::string &cmdLine, const std::vector<FdAction> &fdActions, double seconds,
+                           int signal) {
+    this->removeFinishedJobs();
+    int uniqueID = calcNewID();
+    JobEntry newJob(cmdLine + "&", -1, uniqueID, false);
+    newJob.m_serial = m_nextSerial++;
+    newJob.m_isQueued = true;
+    newJob.m_fdActions = fdActions;
+    newJob.m_timeout = seconds;
+    newJob.m_timeoutSignal = signal;
+    m_jobs.insert({uniqueID, newJob});
+    m_queue.push_back(uniqueID);
+    startQueuedJobs();      //right away unless the queue is on and full
+}
+
+void JobsList::timerFds(std::vector<int> &fds) const {
+    for (const auto &job: m_jobs) {
+        if (job.second.m_timerFd != -1) fds.push_back(job.second.m_timerFd);
+    }
+}
+
+void JobsList::fireTimers() {
+    for (auto &job: m_jobs) {
+        if (job.second.m_timerFd != -1) fireTimer(job.second);
+    }
+}
+
+bool JobsList::signalJob(const JobEntry &job, int signum) const {
+    if (job.m_pidFd == -1) return syscall(SYS_kill, job.m_jobPID, signum) != -1;     //pidfd_open failed
+    return syscall(SYS_pidfd_send_signal, job.m_pidFd, signum, nullptr, 0) != -1;
+}
+
+void JobsList::jobEnded(JobEntry &job, bool succeeded) {
+    if (job.m_timerFd != -1) {
+        close(job.m_timerFd);
+        job.m_timerFd = -1;
+    }
+    if (job.m_pidFd != -1) {
+        close(job.m_pidFd);
+        job.m_pidFd = -1;
+    }
+    for (const std::shared_ptr<JobOutput> &output: m_outputs) {
+        if (output->m_serial == job.m_serial) output->m_running = false;
+    }
+    for (auto &entry: m_jobs) {
+        JobEntry &waiting = entry.second;
+        if (!waiting.m_isWaiting) continue;
+        for (auto iter = waiting.m_after.begin(); iter != waiting.m_after.end(); ++iter) {
+            if (iter->first != job.m_serial) continue;
+            waiting.m_after.erase(iter);
+            if (!succeeded && waiting.m_afterSuccess) waiting.m_afterFailed = true;
+            m_dependentsReady = true;
+            break;
+        }
+    }
+}
+
+void JobsList::releaseDependents() {
+    if (!m_dependentsReady) return;
+    bool queuedAny = false;
+    while (m_dependentsReady) {     //a cancelled job can release or cancel its own dependents
+        m_dependentsReady = false;
+        for (auto iter = m_jobs.begin(); iter != m_jobs.end();) {
+            JobEntry &job = iter->second;
+            if (job.m_isWaiting && job.m_afterFailed) {
+                addFinishedJob(job.m_jobCommandString, -1, iter->first, 0, job.m_startTime);
+                jobEnded(job, false);
+                iter = m_jobs.erase(iter);
+                continue;
+            }
+            if (job.m_isWaiting && job.m_after.empty()) {
+                job.m_isWaiting = false;
+                m_queue.push_back(iter->first);
+                queuedAny = true;
+            }
+            ++iter;
+        }
+    }
+    if (queuedAny) startQueuedJobs();
+}
+
+const std::map<int, JobsList::JobEntry> &JobsList::getJobs() const {
+    return m_jobs;
+}
+
+uint64_t JobsList::getStartedCount() const {
+    return m_startedCount;
+}
+
+uint64_t JobsList::getFinishedCount() const {
+    return m_finishedCount;
+}
+
+void JobsList::printFinishedJobs() {
+    this->removeFinishedJobs();
+    for (const FinishedJob &job: m_finished) {
+        char result[64];
+        if (job.m_pid == -1) {
+            if (job.m_jobID != 0) smashOut() << "[" << job.m_jobID << "] ";
+            smashOut() << job.m_cmdLine << ": cancelled, a prerequisite failed" << '\n';
+            continue;
+        }
+        if (job.m_timedOut) {
+            snprintf(result, sizeof(result), "timed out, %s %d, %.3fs", WIFSIGNALED(job.m_status) ? "signal" : "exit",
+                     WIFSIGNALED(job.m_status) ? WTERMSIG(job.m_status) : WEXITSTATUS(job.m_status), job.m_seconds);
+        } else if (WIFSIGNALED(job.m_status)) {
+            snprintf(result, sizeof(result), "signal %d, %.3fs", WTERMSIG(job.m_status), job.m_seconds);
+        } else {
+            snprintf(result, sizeof(result), "exit %d, %.3fs", WEXITSTATUS(job.m_status), job.m_seconds);
+        }
+        if (job.m_jobID != 0) smashOut() << "[" << job.m_jobID << "] ";
+        smashOut() << job.m_cmdLine << " " << job.m_pid << ": " << result << '\n';
+    }
+}
+
 JobsList::JobEntry *JobsList::getLastStoppedJob(int *jobId) {
     this->removeFinishedJobs();
     if (m_jobs.size() == 0) return nullptr;
@@ -1159,52 +4271,349 @@ JobsList::JobEntry *JobsList::getLastStoppedJob(int *jobId) {
 
 #pragma endregion
 
+//--------------------JOB OUTPUT CAPTURE--------------------//
+#pragma region JOB OUTPUT CAPTURE
+
+JobOutput::JobOutput(int jobID, uint64_t serial, int fd) : m_jobID(jobID), m_serial(serial), m_fd(fd) {}
+
+JobOutput::~JobOutput() {
+    if (m_fd != -1) close(m_fd);
+}
+
+size_t JobOutput::size() const {
+    return m_size;
+}
+
+void JobOutput::copyOut(size_t skip, size_t count, char *to) const {
+    size_t from = (m_start + skip) % m_ring.size();
+    size_t first = std::min(count, m_ring.size() - from);
+    memcpy(to, m_ring.data() + from, first);
+    memcpy(to + first, m_ring.data(), count - first);
+}
+
+void JobOutput::append(const char *data, size_t length, size_t cap) {
+    m_written += length;
+    if (cap == 0) {
+        m_start = m_size = 0;
+        std::vector<char>().swap(m_ring);
+        return;
+    }
+    if (length >= cap) {
+        data += length - cap;
+        length = cap;
+        m_start = m_size = 0;
+    }
+    //grown by doubling, so a job that prints little costs little
+    size_t needed = std::min(cap, m_size + length);
+    if (m_ring.size() < needed || m_ring.size() > cap) {
+        size_t capacity = std::min(cap, std::max(needed, m_ring.size() * 2));
+        size_t keep = std::min(m_size, capacity - length);
+        std::vector<char> resized(capacity);
+        if (keep > 0) copyOut(m_size - keep, keep, resized.data());
+        m_ring.swap(resized);
+        m_start = 0;
+        m_size = keep;
+    }
+    if (m_size + length > m_ring.size()) dropOldest(m_size + length - m_ring.size());
+    size_t to = (m_start + m_size) % m_ring.size();
+    size_t first = std::min(length, m_ring.size() - to);
+    memcpy(m_ring.data() + to, data, first);
+    memcpy(m_ring.data(), data + first, length - first);
+    m_size += length;
+}
+
+size_t JobOutput::dropOldest(size_t length) {
+    length = std::min(length, m_size);
+    if (length > 0) m_start = (m_start + length) % m_ring.size();
+    m_size -= length;
+    return length;
+}
+
+std::string JobOutput::readFrom(uint64_t &offset) const {
+    uint64_t oldest = m_written - m_size;
+    if (offset < oldest) offset = oldest;
+    std::string text(m_written - offset, '\0');
+    if (!text.empty()) copyOut(offset - oldest, text.size(), &text[0]);
+    offset = m_written;
+    return text;
+}
+
+void JobsList::setCapture(bool on, size_t jobCap, size_t totalCap) {
+    std::lock_guard<std::mutex> lock(m_outputLock);
+    m_captureOn = on;
+    m_captureJobCap = jobCap;
+    m_captureTotalCap = totalCap;
+    for (const std::shared_ptr<JobOutput> &output: m_outputs) {
+        m_capturedBytes -= output->dropOldest(output->size() > jobCap ? output->size() - jobCap : 0);
+    }
+    trimOutputs(nullptr);
+}
+
+bool JobsList::openCapture(int fds[2]) {
+    if (!m_captureOn) return false;
+    if (pipe2(fds, O_CLOEXEC) == -1) {
+        printError("pipe");
+        return false;
+    }
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);     //drained until EAGAIN by whatever loop polled it
+    return true;
+}
+
+bool JobsList::getCaptureOn() const {
+    return m_captureOn;
+}
+
+size_t JobsList::getCaptureJobCap() const {
+    return m_captureJobCap;
+}
+
+size_t JobsList::getCaptureTotalCap() const {
+    return m_captureTotalCap;
+}
+
+size_t JobsList::getCapturedBytes() const {
+    return m_capturedBytes;
+}
+
+void JobsList::addOutput(int jobId, uint64_t serial, int fd) {
+    std::lock_guard<std::mutex> lock(m_outputLock);
+    m_outputs.push_back(std::make_shared<JobOutput>(jobId, serial, fd));
+    trimOutputs(nullptr);       //may be one finished capture too many now
+}
+
+std::shared_ptr<JobOutput> JobsList::getOutput(int jobId) const {
+    std::lock_guard<std::mutex> lock(m_outputLock);
+    for (auto iter = m_outputs.rbegin(); iter != m_outputs.rend(); ++iter) {
+        if ((*iter)->m_jobID == jobId) return *iter;
+    }
+    return nullptr;
+}
+
+void JobsList::outputFds(std::vector<int> &fds) const {
+    for (const std::shared_ptr<JobOutput> &output: m_outputs) {
+        if (output->m_fd != -1) fds.push_back(output->m_fd);
+    }
+}
+
+//at most one ring's worth per call, so a follower printing in between sees every byte
+void JobsList::drainOutput(JobOutput &output) {
+    char buffer[KB4 * 16];
+    for (size_t total = 0; output.m_fd != -1 && total < m_captureJobCap;) {
+        long bytesRead = syscall(SYS_read, output.m_fd, buffer, std::min(sizeof(buffer), m_captureJobCap - total));
+        if (bytesRead == -1 && errno == EINTR) continue;
+        if (bytesRead == -1 && errno == EAGAIN) return;
+        std::lock_guard<std::mutex> lock(m_outputLock);
+        m_outputChanged.notify_all();
+        if (bytesRead <= 0) {       //every writer is gone, the job and whatever it left running
+            close(output.m_fd);
+            output.m_fd = -1;
+            return;
+        }
+        total += bytesRead;
+        size_t before = output.size();
+        output.append(buffer, bytesRead, m_captureJobCap);
+        m_capturedBytes = m_capturedBytes - before + output.size();
+        if (m_capturedBytes > m_captureTotalCap) trimOutputs(&output);
+    }
+}
+
+void JobsList::drainOutputs() {
+    //a copy: trimming may drop finished captures from m_outputs meanwhile
+    std::vector<std::shared_ptr<JobOutput>> outputs;
+    for (const std::shared_ptr<JobOutput> &output: m_outputs) {
+        if (output->m_fd != -1) outputs.push_back(output);
+    }
+    for (const std::shared_ptr<JobOutput> &output: outputs) drainOutput(*output);
+}
+
+bool JobsList::readOutput(const JobOutput &output, uint64_t &offset, std::string &text) const {
+    std::lock_guard<std::mutex> lock(m_outputLock);
+    text = output.readFrom(offset);
+    return output.m_fd != -1;
+}
+
+//the interval bounds how late a ctrl-C that came between two notifications is seen
+void JobsList::waitOutput(const JobOutput &output, uint64_t offset) {
+    std::unique_lock<std::mutex> lock(m_outputLock);
+    m_outputChanged.wait_for(lock, std::chrono::milliseconds(100), [&output, offset] {
+        return output.m_written != offset || output.m_fd == -1;
+    });
+}
+
+void JobsList::notifyOutputs() {
+    std::lock_guard<std::mutex> lock(m_outputLock);
+    m_outputChanged.notify_all();
+}
+
+void JobsList::trimOutputs(const JobOutput *writer) {
+    size_t finished = 0;
+    for (const std::shared_ptr<JobOutput> &output: m_outputs) finished += !output->m_running;
+    for (auto iter = m_outputs.begin(); iter != m_outputs.end();) {
+        JobOutput &output = **iter;
+        bool full = m_capturedBytes > m_captureTotalCap || finished > FINISHED_JOBS_KEPT;
+        if (!full) return;
+        if (output.m_running || &output == writer) {
+            ++iter;
+            continue;
+        }
+        m_capturedBytes -= output.size();
+        finished--;
+        iter = m_outputs.erase(iter);
+    }
+    //only running jobs are left: the oldest bytes of the writer, or of the oldest jobs
+    for (const std::shared_ptr<JobOutput> &output: m_outputs) {
+        if (m_capturedBytes <= m_captureTotalCap) return;
+        if (writer != nullptr && output.get() != writer) continue;
+        m_capturedBytes -= output->dropOldest(m_capturedBytes - m_captureTotalCap);
+    }
+}
+
+#pragma endregion
+
 //--------------------COMMAND CLASS--------------------//
 #pragma region COMMAND CLASS
 
-Command::Command(const std::string cmd_line) {
-    std::string cleanLine = _trim(removeBackgroundSign(cmd_line));
-    this->m_cmdLine = cleanLine;
-    this->m_argc = parseCommandLine(cleanLine, &this->m_argv);
-    this->m_isBackgroundCommand = isBackgroundCommand(cmd_line);
+LineArena &LineArena::current() {
+    static thread_local LineArena arena;
+    return arena;
 }
 
-Command::~Command() = default;
-
-RedirectionCommand::RedirectionCommand(const std::string cmd_line) : Command(cmd_line) {
-    size_t sep = m_cmdLine.find('>');
-    // if (sep == std::string::npos) {
-    //     throw std::runtime_error("internal: no redirection symbol");
-    // }
+LineArena::~LineArena() {
+    for (auto &chunk: m_chunks) free(chunk.first);
+}
 
-    // append (>>)
-    if (sep + 1 < m_cmdLine.size() && m_cmdLine[sep + 1] == '>') {
-        m_override = false;  // >>
-        ++sep;
-    } else {
-        m_override = true;    // >
+void *LineArena::allocate(size_t size) {
+    size = (size + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+    while (m_chunk < m_chunks.size() && m_used + size > m_chunks[m_chunk].second) {
+        ++m_chunk;
+        m_used = 0;
     }
+    if (m_chunk == m_chunks.size()) {
+        //first line of this thread, or a line bigger than everything so far
+        size_t chunkSize = std::max<size_t>(size, 64 * 1024);
+        char *memory = (char *) malloc(chunkSize);
+        if (memory == nullptr) throw std::bad_alloc();
+        m_chunks.push_back({memory, chunkSize});
+    }
+    void *result = m_chunks[m_chunk].first + m_used;
+    m_used += size;
+    return result;
+}
 
-    m_commandPart = _trim(m_cmdLine.substr(0, m_cmdLine.find('>')));
+char *LineArena::copy(const char *text, size_t length) {
+    char *result = (char *) allocate(length + 1);
+    memcpy(result, text, length);
+    result[length] = '\0';
+    return result;
+}
 
-    size_t filePos = m_cmdLine.find_first_not_of(" \t\r\n", sep + 1);
-    // if (filePos == std::string::npos) {
-    //     throw std::runtime_error("smash error: redirection – missing file name");
-    // }
-    m_outPathPart = _trim(m_cmdLine.substr(filePos));
+LineArena::Mark LineArena::mark() const {
+    return {m_chunk, m_used};
 }
 
-PipeCommand::PipeCommand(const std::string cmd_line) : Command(cmd_line) {
-    size_t pos = cmd_line.find("|&");
-    if (pos != std::string::npos) {
-        m_toStderr = true;
-    } else {
-        pos = cmd_line.find('|');
-        m_toStderr = false;
+void LineArena::rewind(Mark mark) {
+    m_chunk = mark.m_chunk;
+    m_used = mark.m_used;
+}
+
+//splits a copy of line on whitespace, in place
+static char **tokenizeInArena(const char *line, size_t length, LineArena &arena, int &argc) {
+    char *tokens = arena.copy(line, length);
+    argc = 0;
+    for (size_t i = 0; i < length;) {
+        while (i < length && isspace((unsigned char) tokens[i])) ++i;
+        if (i == length) break;
+        ++argc;
+        while (i < length && !isspace((unsigned char) tokens[i])) ++i;
+    }
+    char **argv = (char **) arena.allocate((argc + 1) * sizeof(char *));
+    int arg = 0;
+    for (size_t i = 0; i < length;) {
+        while (i < length && isspace((unsigned char) tokens[i])) tokens[i++] = '\0';
+        if (i == length) break;
+        argv[arg++] = tokens + i;
+        while (i < length && !isspace((unsigned char) tokens[i])) ++i;
+    }
+    argv[argc] = nullptr;
+    return argv;
+}
+
+Command::Command(const char *cmd_line) : m_isBackgroundCommand(false) {
+    LineArena &arena = LineArena::current();
+    if (t_adoptParsed != nullptr) {
+        //ParseCache hit: the line is already split, only copy the tokens into this line's arena
+        const ParsedLine &parsed = *t_adoptParsed;
+        t_adoptParsed = nullptr;
+        this->m_isBackgroundCommand = parsed.m_isBackground;
+        this->m_cmdLine = arena.copy(parsed.m_cmdLine.data(), parsed.m_cmdLine.size());
+        char *tokens = (char *) arena.allocate(parsed.m_tokens.size());
+        memcpy(tokens, parsed.m_tokens.data(), parsed.m_tokens.size());
+        this->m_argc = parsed.m_argc;
+        this->m_argv = (char **) arena.allocate((this->m_argc + 1) * sizeof(char *));
+        for (int i = 0; i < this->m_argc; ++i) {
+            this->m_argv[i] = tokens;
+            tokens += strlen(tokens) + 1;
+        }
+        this->m_argv[this->m_argc] = nullptr;
+        return;
     }
+    const char *start = cmd_line + strspn(cmd_line, WHITESPACE.c_str());
+    size_t length = strlen(start);
+    while (length > 0 && isspace((unsigned char) start[length - 1])) --length;
+    if (length > 0 && start[length - 1] == '&') {
+        this->m_isBackgroundCommand = true;
+        --length;
+        while (length > 0 && isspace((unsigned char) start[length - 1])) --length;
+    }
+    this->m_cmdLine = arena.copy(start, length);
+    this->m_argv = tokenizeInArena(this->m_cmdLine, length, arena, this->m_argc);
+}
+
+void *Command::operator new(size_t size) {
+    return LineArena::current().allocate(size);
+}
 
-    m_leftCmd = _trim(cmd_line.substr(0, pos));
-    m_rightCmd = _trim(cmd_line.substr(pos + (m_toStderr ? 2 : 1)));
+Command::~Command() = default;
+
+RedirectionCommand::RedirectionCommand(const char *cmd_line) : Command(cmd_line) {
+    std::string commandPart;
+    m_formatError = parseRedirections(m_cmdLine, commandPart, m_fdActions);
+    m_commandPart = LineArena::current().copy(commandPart.c_str(), commandPart.size());
+}
+
+bool RedirectionCommand::needsShellThread() const {
+    size_t wordLength = strcspn(m_commandPart, " \n");
+    if (wordLength > 0 && m_commandPart[wordLength - 1] == '&') --wordLength;
+    const BuiltinSpec *builtin = findBuiltin(m_commandPart, wordLength);
+    return builtin != nullptr && (builtin->m_flags & BUILTIN_SHELL_THREAD);
+}
+
+PipeCommand::PipeCommand(const char *cmd_line) : Command(cmd_line) {
+    LineArena &arena = LineArena::current();
+    const char *pos = strstr(cmd_line, "|&");
+    m_toStderr = pos != nullptr;
+    if (!m_toStderr) pos = strchr(cmd_line, '|');
+
+    const char *leftEnd = pos;
+    while (leftEnd > cmd_line && isspace((unsigned char) leftEnd[-1])) --leftEnd;
+    const char *leftStart = cmd_line + strspn(cmd_line, WHITESPACE.c_str());
+    m_leftCmd = arena.copy(leftStart, leftEnd > leftStart ? leftEnd - leftStart : 0);
+    const char *rightStart = pos + (m_toStderr ? 2 : 1);
+    rightStart += strspn(rightStart, WHITESPACE.c_str());
+    m_pipeSize = 0;
+    //per-pipeline buffer size: "cmd1 |[1M] cmd2"
+    //anything else in brackets belongs to the command ([ -f x ], [junk])
+    const char *close = strchr(rightStart, ']');
+    if (*rightStart == '[' && close != nullptr) {
+        if (parseSize(std::string(rightStart + 1, close), m_pipeSize)) {
+            rightStart = close + 1;
+            rightStart += strspn(rightStart, WHITESPACE.c_str());
+        } else {
+            m_pipeSize = 0;
+        }
+    }
+    //the '&' of the whole line stays on the right stage, like before
+    m_rightCmd = arena.copy(rightStart, strlen(rightStart));
 }
 
 bool Command::getIsBackgroundCommand() {
@@ -1215,9 +4624,37 @@ std::string Command::getCmdLine() {
     return this->m_cmdLine;
 }
 
+void Command::setFdActions(const std::vector<FdAction> &actions) {
+    this->m_fdActions = actions;
+}
+
+const std::vector<FdAction> &Command::getFdActions() const {
+    return this->m_fdActions;
+}
+
+bool Command::needsShellThread() const {
+    return this->m_shellThreadOnly;
+}
+
+bool Command::followsJobOutput() const {
+    return false;
+}
+
+void Command::setShellThreadOnly(bool only) {
+    this->m_shellThreadOnly = only;
+}
+
+int Command::getArgc() const {
+    return this->m_argc;
+}
+
+char *const *Command::getArgv() const {
+    return this->m_argv;
+}
+
 std::string Command::getCmdLineFull() {
     if (this->m_isBackgroundCommand) {
-        return this->m_cmdLine + "&";
+        return std::string(this->m_cmdLine) + "&";
     }
     return this->m_cmdLine;
 }
@@ -2,29 +2,154 @@
 #ifndef SMASH_COMMAND_H_
 #define SMASH_COMMAND_H_
 
+#include <condition_variable>
+#include <ctime>
+#include <deque>
+#include <list>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <thread>
 #include <unordered_map>
 #include <utility>
 #include <vector>
+#include "DirIndex.h"
+#include "History.h"
+#include "StatusPage.h"
 
 #define COMMAND_MAX_LENGTH (200)
 #define COMMAND_MAX_ARGS (20)
 #define PATH_MAX (4096)
 #define KB4 (4096)
 
+//one fd manipulation of a redirection. applied in the child between fork and exec
+//for external commands, or around execute() for commands that run inside smash.
+struct FdAction {
+    int m_targetFd;
+    int m_sourceFd;     //when m_path is empty: dup2(m_sourceFd, m_targetFd)
+    int m_flags;        //open() flags for m_path
+    std::string m_path;
+};
+
+#define OUTPUT_BUFFER_LIMIT (1 << 20)
+
+//buffered std::streambuf over a raw fd. the buffer grows up to OUTPUT_BUFFER_LIMIT and is
+//written with a single write() on flush, so a built-in listing 1000 lines costs one syscall.
+//a write error (e.g. EPIPE after the reader of a pipe exited) drops the rest of the output
+//instead of retrying on every flush.
+class FdStreamBuf : public std::streambuf {
+    int m_fd;
+    bool m_failed;
+    std::vector<char> m_buffer;
+
+    bool flushBuffer();
+
+protected:
+    int overflow(int c) override;
+
+    int sync() override;
+
+public:
+    explicit FdStreamBuf(int fd);
+
+    ~FdStreamBuf() override;
+};
+
+//where the running built-in reads and writes. smash's own thread uses fds 0/1/2 through
+//std::cout/std::cerr; built-ins running as a pipeline stage or under a redirection get
+//their own fds. external commands dup2 these fds onto 0/1/2 in the child before exec.
+struct IoContext {
+    int m_inFd;
+    int m_outFd;
+    int m_errFd;
+    std::ostream *m_out;
+    std::ostream *m_err;
+};
+
+//smash's own thread writes its built-ins' output into one shell-wide buffer on fd 1.
+//it is flushed once per prompt (together with the prompt), before forking and by
+//anything that writes to the fd directly. std::cerr is tied to it to keep the order.
+const IoContext &currentIo();
+
+std::ostream &smashOut();
+
+std::ostream &smashErr();
+
+//replaces the calling thread's IoContext until destroyed. streams are reused when an fd
+//did not change, so already buffered output keeps its order.
+class ScopedIo {
+    IoContext m_saved;
+    FdStreamBuf m_outBuf;
+    FdStreamBuf m_errBuf;
+    std::ostream m_out;
+    std::ostream m_err;
+public:
+    ScopedIo(int inFd, int outFd, int errFd);
+
+    ScopedIo(ScopedIo const &) = delete;
+
+    void operator=(ScopedIo const &) = delete;
+
+    ~ScopedIo();
+};
+
+//bump allocator for everything parsed from one input line: the Command objects, their
+//trimmed line and argv. executeCommand rewinds it when the line is done, so creating and
+//dispatching a command does not call malloc. one arena per thread, because pipeline stage
+//threads create the commands of nested stages themselves.
+class LineArena {
+public:
+    struct Mark {
+        size_t m_chunk;
+        size_t m_used;
+    };
+
+    static LineArena &current();
+
+    LineArena() = default;
+
+    LineArena(LineArena const &) = delete;
+
+    void operator=(LineArena const &) = delete;
+
+    ~LineArena();
+
+    void *allocate(size_t size);
+
+    //NUL-terminated copy of text[0, length)
+    char *copy(const char *text, size_t length);
+
+    Mark mark() const;
+
+    void rewind(Mark mark);
+
+private:
+    std::vector<std::pair<char *, size_t>> m_chunks;
+    size_t m_chunk = 0;
+    size_t m_used = 0;
+};
 
 class Command {
 protected:
-    std::string m_cmdLine;
-    std::vector<std::string> m_argv;
+    const char *m_cmdLine;      //trimmed, without the '&'
+    char **m_argv;              //NULL-terminated, ready for execv
     int m_argc;
     bool m_isBackgroundCommand;
+    std::vector<FdAction> m_fdActions;
+    bool m_shellThreadOnly = false;
 public:
-    Command(const std::string cmd_line);
+    Command(const char *cmd_line);
 
     virtual ~Command();
 
+    //commands live in the LineArena of the thread that created them, delete only runs the dtor
+    static void *operator new(size_t size);
+
+    static void operator delete(void *) {}
+
     virtual void execute() = 0;
 
     bool getIsBackgroundCommand();
@@ -32,10 +157,70 @@ public:
     std::string getCmdLine();
 
     std::string getCmdLineFull();
+
+    int getArgc() const;
+
+    char *const *getArgv() const;
+
+    void setFdActions(const std::vector<FdAction> &actions);
+
+    const std::vector<FdAction> &getFdActions() const;
+
+    //whether it changes smash's own state or the job list, so a pipeline may not run it on a
+    //stage thread (BUILTIN_SHELL_THREAD)
+    virtual bool needsShellThread() const;
+
+    //jobs -f: a stage that waits for smash's thread to drain the capture pipes, so a pipeline
+    //keeps serving the jobs while it runs
+    virtual bool followsJobOutput() const;
+
+    void setShellThreadOnly(bool only);
     //virtual void prepare();
     //virtual void cleanup();
 };
 
+#define FINISHED_JOBS_KEPT (100)
+#define CAPTURE_JOB_CAP (64 << 10)           //jobs -c defaults: ring size per job
+#define CAPTURE_TOTAL_CAP (16 << 20)         //and all rings together
+
+//jobs -c: a background job's stdout and stderr, read from a pipe into a ring buffer that
+//keeps the newest bytes
+class JobOutput {
+    std::vector<char> m_ring;       //grows up to the job cap
+    size_t m_start = 0;             //index of the oldest byte kept
+    size_t m_size = 0;
+
+    //count bytes, starting skip bytes after the oldest one
+    void copyOut(size_t skip, size_t count, char *to) const;
+
+public:
+    int m_jobID;
+    uint64_t m_serial;
+    int m_fd;                       //read end of the pipe, -1 once it reached EOF
+    bool m_running = true;
+    uint64_t m_written = 0;         //bytes ever read; the oldest kept is at m_written - size()
+
+    JobOutput(int jobID, uint64_t serial, int fd);
+
+    JobOutput(const JobOutput &) = delete;
+
+    JobOutput &operator=(const JobOutput &) = delete;
+
+    ~JobOutput();
+
+    size_t size() const;
+
+    //keeps at most cap bytes, the oldest are dropped first
+    void append(const char *data, size_t length, size_t cap);
+
+    //drops up to length of the oldest bytes, returns how many
+    size_t dropOldest(size_t length);
+
+    //what was written from offset on; an offset that was dropped already moves up to the oldest
+    //byte kept. offset ends up at m_written
+    std::string readFrom(uint64_t &offset) const;
+};
+
 class JobsList {
 public:
     class JobEntry {
@@ -44,14 +229,71 @@ public:
         pid_t m_jobPID;
         int m_jobID;
         bool m_isStopped;
+        struct timespec m_startTime;    //CLOCK_MONOTONIC when it was added (queued: when it started)
+        bool m_isQueued = false;        //waiting for a free slot, m_jobPID is -1
+        std::vector<FdAction> m_fdActions;  //redirections to apply when a queued job starts
+        uint64_t m_serial = 0;          //unique for the session, job ids are reused
+        //after: still queued but not in the queue until these jobs (serial, job id) have exited
+        std::vector<std::pair<uint64_t, int>> m_after;
+        bool m_isWaiting = false;
+        bool m_afterSuccess = false;    //-s: cancelled if one of them fails
+        bool m_afterFailed = false;
+        //timeout: m_timeoutSignal goes to the process group m_timeout seconds after the start
+        double m_timeout = 0;
+        int m_timeoutSignal = 0;
+        int m_timerFd = -1;             //timerfd while armed
+        bool m_timedOut = false;
+        int m_pidFd = -1;               //pidfd of m_jobPID from its start until it is reaped, for kill
 
         JobEntry(std::string commandString, pid_t PID, int ID, bool isStopped) : m_jobCommandString(commandString),
                                                                                  m_jobPID(PID), m_jobID(ID),
-                                                                                 m_isStopped(isStopped) {};
+                                                                                 m_isStopped(isStopped) {
+            clock_gettime(CLOCK_MONOTONIC, &m_startTime);
+        };
+    };
+
+    //a job or parallel task that was reaped, for jobs -d
+    struct FinishedJob {
+        std::string m_cmdLine;
+        pid_t m_pid;
+        int m_jobID;            //0 for parallel tasks, they never were in the list
+        int m_status;           //as returned by wait
+        double m_seconds;
+        bool m_timedOut;
     };
 
 private:
     std::map<int, JobEntry> m_jobs;
+    std::deque<FinishedJob> m_finished;     //oldest first, at most FINISHED_JOBS_KEPT
+    bool m_queueOn = false;
+    size_t m_jobLimit = 1;
+    std::deque<int> m_queue;                //ids of the queued jobs, next to start first
+    uint64_t m_startedCount = 0;            //for the status page
+    uint64_t m_finishedCount = 0;
+    uint64_t m_nextSerial = 1;
+    bool m_dependentsReady = false;         //a job some waiting job depends on has exited
+    std::deque<std::shared_ptr<JobOutput>> m_outputs;     //jobs -c rings, oldest first
+    bool m_captureOn = false;
+    size_t m_captureJobCap = CAPTURE_JOB_CAP;
+    size_t m_captureTotalCap = CAPTURE_TOTAL_CAP;
+    size_t m_capturedBytes = 0;             //in all rings
+    //m_outputs and the rings: jobs -f on a stage thread reads them while smash's thread drains
+    mutable std::mutex m_outputLock;
+    std::condition_variable m_outputChanged;    //a ring grew or its pipe reached EOF
+
+    bool launchJob(JobEntry &job);
+
+    //tells the jobs waiting for job that it is gone, disarms its timeout
+    void jobEnded(JobEntry &job, bool succeeded);
+
+    //queues the waiting jobs whose prerequisites are all gone, cancels the ones with a failed one
+    void releaseDependents();
+
+    void addOutput(int jobId, uint64_t serial, int fd);
+
+    //back under the shell-wide cap: the rings of finished jobs go first, oldest first, then the
+    //oldest bytes of writer. m_outputLock held
+    void trimOutputs(const JobOutput *writer);
 
 
 public:
@@ -61,7 +303,8 @@ public:
 
     ~JobsList() = default;
 
-    void addJob(Command *cmd, bool isStopped = false, pid_t jobPID = -1); // had to add defult arg to pid_t
+    //outputFd: the read end of its openCapture() pipe, if any
+    void addJob(Command *cmd, bool isStopped = false, pid_t jobPID = -1, int outputFd = -1); // had to add defult arg to pid_t
 
     void printJobsList();
 
@@ -71,12 +314,188 @@ public:
 
     JobEntry *getJobById(int jobId); //remember returns nullptr if doesnt exist.
 
-    void removeJobById(int jobId);
+    void removeJobById(int jobId, bool succeeded = false);
 
     JobEntry *getLastJob(int *lastJobId);
 
     JobEntry *getLastStoppedJob(int *jobId);
 
+    void addFinishedJob(const std::string &cmdLine, pid_t pid, int jobId, int status,
+                        const struct timespec &startTime, bool timedOut = false);
+
+    void printFinishedJobs();
+
+    const std::map<int, JobEntry> &getJobs() const;
+
+    uint64_t getStartedCount() const;
+
+    uint64_t getFinishedCount() const;
+
+    //jobq: with the queue on, a background job beyond the limit waits instead of starting
+    void setQueue(bool on, size_t limit);
+
+    bool getQueueOn() const;
+
+    size_t getJobLimit() const;
+
+    size_t runningCount();
+
+    size_t queuedCount() const;
+
+    //true if cmd was queued rather than to be started now
+    bool queueJob(Command *cmd);
+
+    //starts queued jobs while there are free slots (all of them with the queue off)
+    void startQueuedJobs();
+
+    //starts one queued job now (fg). false if it could not be started
+    bool startJob(int jobId);
+
+    //false if jobId is not queued
+    bool moveQueued(int jobId, bool toFront);
+
+    //drops a queued or waiting job
+    bool dropQueued(int jobId);
+
+    //after: a job started once the jobs in after have exited. returns its id
+    int addDependentJob(const std::string &cmdLine, const std::vector<FdAction> &fdActions,
+                        const std::vector<int> &after, bool requireSuccess);
+
+    //timeout ... &: a background job signalled after seconds, started through the queue
+    void addTimedJob(const std::string &cmdLine, const std::vector<FdAction> &fdActions, double seconds,
+                     int signal);
+
+    //timerfds of the armed timeouts, for the prompt and foreground waits to poll
+    void timerFds(std::vector<int> &fds) const;
+
+    //signals the jobs whose timeout expired
+    void fireTimers();
+
+    //sends signum to the job's process through its pidfd, which can't reach a recycled pid.
+    //false (errno set) if it failed
+    bool signalJob(const JobEntry &job, int signum) const;
+
+    //jobs -c: whether new background jobs get their output captured, and the ring sizes
+    void setCapture(bool on, size_t jobCap, size_t totalCap);
+
+    //true with capture on: fds[1] is to be the new background job's stdout and stderr, fds[0]
+    //goes to addJob() once it runs
+    bool openCapture(int fds[2]);
+
+    bool getCaptureOn() const;
+
+    size_t getCaptureJobCap() const;
+
+    size_t getCaptureTotalCap() const;
+
+    size_t getCapturedBytes() const;
+
+    //the newest capture of jobId, running or finished. nullptr if there is none
+    std::shared_ptr<JobOutput> getOutput(int jobId) const;
+
+    //the capture pipes still open, for the prompt and foreground waits to poll
+    void outputFds(std::vector<int> &fds) const;
+
+    //reads what one capture pipe holds, up to the job cap
+    void drainOutput(JobOutput &output);
+
+    //reads every capture pipe that has data
+    void drainOutputs();
+
+    //what output holds from offset on, any thread. false once its pipe reached EOF
+    bool readOutput(const JobOutput &output, uint64_t &offset, std::string &text) const;
+
+    //off smash's thread: waits (up to a poll interval) for output to get past offset or reach EOF
+    void waitOutput(const JobOutput &output, uint64_t offset);
+
+    //wakes waitOutput() callers, e.g. to look at a ctrl-C
+    void notifyOutputs();
+
+};
+
+//how often one pipeline stage was found blocked on its pipe, sampled from the task's wchan
+struct PipeStageStats {
+    std::string m_cmdLine;
+    long m_samples;
+    long m_blockedFull;     //writer waiting for the reader to drain the pipe
+    long m_blockedEmpty;    //reader waiting for the writer to fill it
+};
+
+struct BuiltinSpec;
+
+//coproc: a long-lived helper whose stdin and stdout are pipes held by smash. it is a job like
+//any other; the entry goes once that job is gone and its output was read to the end
+struct Coproc {
+    std::string m_name;
+    pid_t m_pid;
+    int m_toFd;                 //the helper's stdin
+    int m_fromFd;               //the helper's stdout
+    std::string m_pending;      //read from m_fromFd past the last line handed out
+
+    Coproc(const std::string &name, pid_t pid, int toFd, int fromFd);
+
+    Coproc(Coproc const &) = delete;
+
+    void operator=(Coproc const &) = delete;
+
+    ~Coproc();
+};
+
+//how externals are started, from $SMASH_LAUNCH (fork or spawn) at startup
+enum LaunchMode {
+    LAUNCH_MODE_FORK,       //fork + exec, the exec is timed by stats
+    LAUNCH_MODE_SPAWN       //posix_spawn, no copy of smash's page tables
+};
+
+//who expands * and ?, from $SMASH_GLOB (bash or internal) at startup
+enum GlobMode {
+    GLOB_MODE_BASH,         //every such line runs under /bin/bash -c
+    GLOB_MODE_INTERNAL      //glob(3) in smash when the line has no other bash syntax
+};
+
+//how CreateCommand dispatched a line, so a cache hit can skip straight to the constructor
+enum ParsedKind {
+    PARSED_BUILTIN,
+    PARSED_REDIRECTION,
+    PARSED_PIPE,
+    PARSED_EXTERNAL
+};
+
+//one input line as CreateCommand understood it
+struct ParsedLine {
+    std::string m_rawLine;          //the cache key, exactly as typed
+    std::string m_expandedLine;     //trimmed and alias-expanded, what the constructor gets
+    ParsedKind m_kind;
+    const BuiltinSpec *m_builtin;
+    std::string m_cmdLine;          //Command::m_cmdLine
+    std::string m_tokens;           //argv strings back to back, each NUL-terminated
+    int m_argc;
+    bool m_isBackground;
+    std::string m_execPath;         //externals: PATH resolved once, empty = let execvp search
+};
+
+//LRU cache of parsed lines for scripts and loops that repeat the same lines. lookups do
+//not allocate. it is dropped whenever the aliases or PATH change.
+class ParseCache {
+    std::list<ParsedLine> m_lru;    //most recent first
+    std::unordered_map<uint64_t, std::list<ParsedLine>::iterator> m_index;
+    std::string m_path;             //PATH the entries were resolved against
+    long m_hits = 0;
+    long m_misses = 0;
+public:
+    static const size_t CAPACITY = 256;
+
+    const ParsedLine *find(const char *rawLine);
+
+    void insert(ParsedLine &&parsed);
+
+    void clear();
+
+    size_t size() const;
+
+    long getHits() const;
+
+    long getMisses() const;
 };
 
 class SmallShell {
@@ -85,10 +504,38 @@ private:
     JobsList m_jobsList;
     std::string m_lastPWD;
     pid_t m_fgProcPID = -1;
-    std::string m_fgCmd;
+    const char *m_fgCmd = "";    //the running Command's line, lives in its LineArena
+    int m_pipeSize = 0;     //F_SETPIPE_SZ for new pipes, 0 keeps the kernel default
+    bool m_pipeTrace = false;
+    LaunchMode m_launchMode = LAUNCH_MODE_FORK;
+    GlobMode m_globMode = GLOB_MODE_BASH;
+    bool m_textBuiltins = true;     //wc/head/grep in smash, $SMASH_TEXT_BUILTINS=off runs the real ones
+    bool m_interactive = false;     //stdin is a terminal: lines go to history, cd feeds the directory index
+    int m_pipeDepth = 0;
+    std::vector<PipeStageStats> m_pipeStats;
+    ParseCache m_parseCache;
+    History m_history;
+    DirIndex m_dirIndex;
+    std::vector<std::string> m_dirStack;    //pushd/popd, top at the back
+    std::thread::id m_shellThread;
+    //alias -> its value with the first word expanded through every other alias, built by aliasesChanged
+    std::unordered_map<std::string, std::string> m_compiledAliases;
+    StatusPage m_statusPage;
+    uint64_t m_commandCount = 0;
+    std::map<std::string, std::shared_ptr<Coproc>> m_coprocs;
+    std::mutex m_coprocLock;            //send/receive may run on pipeline stage threads
+
+    //drops the coprocs whose job is gone and whose output is drained. m_coprocLock held. only on
+    //smash's thread, the job list is not a stage thread's to look at; a stage sees the entries as
+    //they were
+    void pruneCoprocs();
 
     SmallShell();
 
+    bool compileAlias(const std::string &name, std::string &expansion) const;
+
+    Command *instantiate(const char *cmd_s, ParsedKind kind, const BuiltinSpec *builtin);
+
 public:
     std::unordered_map<std::string, std::string> m_aliasMap;
 
@@ -111,7 +558,7 @@ public:
 
     void setPrompt(std::string value);
 
-    std::string getLastPWD();
+    const std::string &getLastPWD();
 
     void setLastPWD(std::string value);
 
@@ -121,35 +568,123 @@ public:
 
     std::string getFgProcCmd() const;
 
-    void setFgProcCmd(std::string cmdLine);
+    void setFgProcCmd(const char *cmdLine);
 
     void clearFgJob();
 
+    //for the SIGINT handler: only forgets the pid. clearFgJob() publishes the status page, which
+    //is not async-signal-safe; the waiter or the main loop publishes once it sees the ctrl-C
+    void dropFgProcPID();
+
     JobsList &getJobsList();
 
-    bool isAlias(std::string cmd_line);
+    //cmd_s with a leading alias expanded, copied into the line arena. cmd_s itself if there is none
+    const char *expandAlias(const char *cmd_s);
+
+    int getPipeSize() const;
+
+    void setPipeSize(int size);
+
+    bool getPipeTrace() const;
+
+    LaunchMode getLaunchMode() const;
+
+    GlobMode getGlobMode() const;
+
+    bool getTextBuiltins() const;
+
+    bool isInteractive() const;
+
+    void setPipeTrace(bool on);
+
+    //depth of nested PipeCommands currently executing. entering the outermost one clears the stats
+    void enterPipeline();
+
+    void leavePipeline();
+
+    std::vector<PipeStageStats> &getPipeStats();
+
+    ParseCache &getParseCache();
+
+    History &getHistory();
+
+    DirIndex &getDirIndex();
+
+    std::vector<std::string> &getDirStack();
+
+    //a child exited or a job timeout expired: signal, reap, and start what was waiting for it
+    void serviceJobs();
+
+    //rewrites the status page from the jobs list. shell thread only
+    void publishStatus();
+
+    //quit: smash exits without running destructors
+    void removeStatusPage();
+
+    //what the prompt and foreground waits poll to call serviceJobs(): the SIGCHLD pipe and
+    //the job timers. empty until jobq/after/timeout first needed them
+    void jobEventFds(std::vector<int> &fds) const;
+
+    //alias/unalias changed m_aliasMap: recompile every alias. false, and nothing
+    //changes, if an alias would expand back into another one on its chain
+    bool aliasesChanged();
+
+    bool isShellThread() const;
+
+    //nullptr if there is no coproc called name
+    std::shared_ptr<Coproc> getCoproc(const std::string &name);
+
+    //replaces a coproc of the same name, whose pipes are closed once nothing uses it
+    void addCoproc(const std::shared_ptr<Coproc> &coproc);
+
+    std::vector<std::shared_ptr<Coproc>> getCoprocs();
+
+};
+
 
-    std::string fixAliasCmdLine(std::string cmd_line);
+//a command smash runs itself. the table in Commands.cpp is the only place one is
+//registered: CreateCommand dispatches through it and alias rejects its names.
+enum BuiltinFlags {
+    BUILTIN_RAW_LINE = 1,   //gets the whole line even if it contains |, < or > (alias)
+    BUILTIN_SPECIAL = 2,    //one of the "special" commands of the spec (du, whoami, netinfo)
+    BUILTIN_SHELL_THREAD = 4    //touches smash's state or the job list: never on a pipeline stage thread
+};
+
+struct BuiltinSpec {
+    const char *m_name;
 
+    Command *(*m_factory)(const char *cmdLine, SmallShell &smash);
 
+    int m_flags;
 };
 
+//nullptr if the first length chars of name are not a built-in
+const BuiltinSpec *findBuiltin(const char *name, size_t length);
+
+//every built-in name, for completion
+void builtinNames(std::vector<std::string> &names);
 
 class BuiltInCommand : public Command {
 
 public:
-    BuiltInCommand(const std::string cmd_line) : Command(cmd_line) {};
+    BuiltInCommand(const char *cmd_line) : Command(cmd_line) {};
 
     virtual ~BuiltInCommand() {}
 };
 
 class ExternalCommand : public Command {
+    const char *m_execPath = nullptr;   //resolved by the ParseCache, execvp searches PATH if null
 public:
-    ExternalCommand(const std::string cmd_line) : Command(cmd_line) {};
+    ExternalCommand(const char *cmd_line) : Command(cmd_line) {};
 
     virtual ~ExternalCommand() {}
 
     void execute() override;
+
+    //fork + exec (or posix_spawn) with the calling thread's IoContext and the fd actions. returns the pid or -1
+    pid_t spawn();
+
+    void setExecPath(const char *path);
 };
 
 ////Eitan added ComplexExternalCommand
@@ -166,7 +701,7 @@ public:
 //chprompt
 class ChPromptCommand : public BuiltInCommand {
 public:
-    ChPromptCommand(const std::string cmd_line) : BuiltInCommand(cmd_line) {}
+    ChPromptCommand(const char *cmd_line) : BuiltInCommand(cmd_line) {}
 
     virtual ~ChPromptCommand() {}
 
@@ -176,7 +711,7 @@ public:
 //showpid
 class ShowPidCommand : public BuiltInCommand {
 public:
-    ShowPidCommand(const std::string cmd_line) : BuiltInCommand(cmd_line) {};
+    ShowPidCommand(const char *cmd_line) : BuiltInCommand(cmd_line) {};
 
     virtual ~ShowPidCommand() {}
 
@@ -186,7 +721,7 @@ public:
 //pwd
 class GetCurrDirCommand : public BuiltInCommand {
 public:
-    GetCurrDirCommand(const std::string cmd_line) : BuiltInCommand(cmd_line) {};
+    GetCurrDirCommand(const char *cmd_line) : BuiltInCommand(cmd_line) {};
 
     virtual ~GetCurrDirCommand() {}
 
@@ -196,29 +731,33 @@ public:
 //cd
 class ChangeDirCommand : public BuiltInCommand {
 public:
-    std::string m_preChangePWD;
+    const std::string &m_preChangePWD;
 
-    ChangeDirCommand(const std::string cmd_line) = delete;
+    ChangeDirCommand(const char *cmd_line) = delete;
 
-    ChangeDirCommand(const std::string cmd_line, std::string plastPwd) : BuiltInCommand(
-            cmd_line) { m_preChangePWD = plastPwd; };
+    ChangeDirCommand(const char *cmd_line, const std::string &plastPwd) : BuiltInCommand(
+            cmd_line), m_preChangePWD(plastPwd) {};
 
     virtual ~ChangeDirCommand() {}
 
     void execute() override;
 };
 
-//jobs
+//jobs [-d | -c [on [job-size [total-size]] | off] | -o <id> | -f <id>]
 //No direct system calls needed.
 //Use internal job list (vector/map with PIDs + metadata)
 //waitpid(pid, ...) with WNOHANG to check if jobs are still running
 class JobsCommand : public BuiltInCommand {
     JobsList &m_jobsListRef;
 public:
-    JobsCommand(const std::string cmd_line, JobsList &jobs) : BuiltInCommand(cmd_line), m_jobsListRef(jobs) {};
+    JobsCommand(const char *cmd_line, JobsList &jobs) : BuiltInCommand(cmd_line), m_jobsListRef(jobs) {};
 
     virtual ~JobsCommand() {}
 
+    bool needsShellThread() const override;     //all but -f, which streams as a stage
+
+    bool followsJobOutput() const override;
+
     void execute() override;
 };
 
@@ -226,7 +765,7 @@ public:
 class ForegroundCommand : public BuiltInCommand {
     JobsList &m_jobsListRef;
 public:
-    ForegroundCommand(const std::string cmd_line, JobsList &jobs) : BuiltInCommand(cmd_line), m_jobsListRef(jobs) {};
+    ForegroundCommand(const char *cmd_line, JobsList &jobs) : BuiltInCommand(cmd_line), m_jobsListRef(jobs) {};
 
     virtual ~ForegroundCommand() {}
 
@@ -237,18 +776,19 @@ public:
 class QuitCommand : public BuiltInCommand {
     JobsList &m_jobsListRef;
 public:
-    QuitCommand(const std::string cmd_line, JobsList &jobs) : BuiltInCommand(cmd_line), m_jobsListRef(jobs) {};
+    QuitCommand(const char *cmd_line, JobsList &jobs) : BuiltInCommand(cmd_line), m_jobsListRef(jobs) {};
 
     virtual ~QuitCommand() {}
 
     void execute() override;
 };
 
-//kill
+//kill -<signal> <job>..., a job being N, %N, a range %N-%M, %running, %stopped or %?text
+//(every job whose command contains text)
 class KillCommand : public BuiltInCommand {
     JobsList &m_jobsListRef;
 public:
-    KillCommand(const std::string cmd_line, JobsList &jobs) : BuiltInCommand(cmd_line), m_jobsListRef(jobs) {};
+    KillCommand(const char *cmd_line, JobsList &jobs) : BuiltInCommand(cmd_line), m_jobsListRef(jobs) {};
 
     virtual ~KillCommand() {}
 
@@ -258,7 +798,7 @@ public:
 //alias
 class AliasCommand : public BuiltInCommand {
 public:
-    AliasCommand(const std::string cmd_line) : BuiltInCommand(cmd_line) {};
+    AliasCommand(const char *cmd_line) : BuiltInCommand(cmd_line) {};
 
     virtual ~AliasCommand() {
     }
@@ -269,7 +809,7 @@ public:
 //unalias
 class UnAliasCommand : public BuiltInCommand {
 public:
-    UnAliasCommand(const std::string cmd_line) : BuiltInCommand(cmd_line) {};
+    UnAliasCommand(const char *cmd_line) : BuiltInCommand(cmd_line) {};
 
     virtual ~UnAliasCommand() {
     }
@@ -280,7 +820,7 @@ public:
 //unsetenv
 class UnSetEnvCommand : public BuiltInCommand {
 public:
-    UnSetEnvCommand(const std::string cmd_line) : BuiltInCommand(cmd_line) {};
+    UnSetEnvCommand(const char *cmd_line) : BuiltInCommand(cmd_line) {};
 
     virtual ~UnSetEnvCommand() {
     }
@@ -291,7 +831,7 @@ public:
 //watchproc
 class WatchProcCommand : public BuiltInCommand {
 public:
-    WatchProcCommand(const std::string cmd_line) : BuiltInCommand(cmd_line) {};
+    WatchProcCommand(const char *cmd_line) : BuiltInCommand(cmd_line) {};
 
     virtual ~WatchProcCommand() {
     }
@@ -300,25 +840,259 @@ public:
 };
 
 
+//cat
+//moves data inside the kernel (copy_file_range/splice/sendfile) when the fds allow it
+class CatCommand : public BuiltInCommand {
+public:
+    CatCommand(const char *cmd_line) : BuiltInCommand(cmd_line) {};
+
+    virtual ~CatCommand() {
+    }
+
+    void execute() override;
+};
+
+//tee
+//duplicates pipe input with tee(2) + splice when both ends are pipes
+class TeeCommand : public BuiltInCommand {
+public:
+    TeeCommand(const char *cmd_line) : BuiltInCommand(cmd_line) {};
+
+    virtual ~TeeCommand() {
+    }
+
+    void execute() override;
+};
+
+//wc, head and grep -F: counted and searched in smash (TextScan kernels) instead of a fork + exec
+//per pipeline stage. any flag they do not know, and any input they cannot open, hands the line
+//to the real tool so its output and errors stay exact. $SMASH_TEXT_BUILTINS=off always does.
+
+//wc: -l and -c (--lines, --bytes)
+class WordCountCommand : public BuiltInCommand {
+public:
+    WordCountCommand(const char *cmd_line) : BuiltInCommand(cmd_line) {};
+
+    virtual ~WordCountCommand() {
+    }
+
+    void execute() override;
+};
+
+//head: -n N, -c N, -N (--lines=N, --bytes=N)
+class HeadCommand : public BuiltInCommand {
+public:
+    HeadCommand(const char *cmd_line) : BuiltInCommand(cmd_line) {};
+
+    virtual ~HeadCommand() {
+    }
+
+    void execute() override;
+};
+
+//grep -F with -v, -c, -n, -q and an ASCII pattern, in the C or a UTF-8 locale
+class GrepCommand : public BuiltInCommand {
+public:
+    GrepCommand(const char *cmd_line) : BuiltInCommand(cmd_line) {};
+
+    virtual ~GrepCommand() {
+    }
+
+    void execute() override;
+};
+
+
+//pushd
+class PushDirCommand : public BuiltInCommand {
+public:
+    PushDirCommand(const char *cmd_line) : BuiltInCommand(cmd_line) {};
+
+    virtual ~PushDirCommand() {}
+
+    void execute() override;
+};
+
+//popd
+class PopDirCommand : public BuiltInCommand {
+public:
+    PopDirCommand(const char *cmd_line) : BuiltInCommand(cmd_line) {};
+
+    virtual ~PopDirCommand() {}
+
+    void execute() override;
+};
+
+//dirs
+class DirsCommand : public BuiltInCommand {
+public:
+    DirsCommand(const char *cmd_line) : BuiltInCommand(cmd_line) {};
+
+    virtual ~DirsCommand() {}
+
+    void execute() override;
+};
+
+//z - jump to the best ranked visited directory matching the args
+class JumpCommand : public BuiltInCommand {
+public:
+    JumpCommand(const char *cmd_line) : BuiltInCommand(cmd_line) {};
+
+    virtual ~JumpCommand() {}
+
+    void execute() override;
+};
+
+//parallel [-j N] [-g] cmd [::: args]
+class ParallelCommand : public BuiltInCommand {
+public:
+    ParallelCommand(const char *cmd_line) : BuiltInCommand(cmd_line) {};
+
+    virtual ~ParallelCommand() {}
+
+    void execute() override;
+};
+
+//after [-s] %<id>... command
+class AfterCommand : public BuiltInCommand {
+    JobsList &m_jobsListRef;
+public:
+    AfterCommand(const char *cmd_line, JobsList &jobs) : BuiltInCommand(cmd_line), m_jobsListRef(jobs) {};
+
+    virtual ~AfterCommand() {}
+
+    void execute() override;
+};
+
+//timeout [-s SIG] <duration> command. the duration takes an s/m/h/d suffix
+class TimeoutCommand : public BuiltInCommand {
+    JobsList &m_jobsListRef;
+public:
+    TimeoutCommand(const char *cmd_line, JobsList &jobs) : BuiltInCommand(cmd_line), m_jobsListRef(jobs) {};
+
+    virtual ~TimeoutCommand() {}
+
+    void execute() override;
+};
+
+//watch [-n sec] [-c count] command. the command may contain pipes and redirections
+class WatchCommand : public BuiltInCommand {
+public:
+    WatchCommand(const char *cmd_line) : BuiltInCommand(cmd_line) {};
+
+    virtual ~WatchCommand() {}
+
+    void execute() override;
+};
+
+//coproc [name command]: starts command as a job with its stdin and stdout on pipes to smash.
+//without arguments lists the coprocs
+class CoprocCommand : public BuiltInCommand {
+    JobsList &m_jobsListRef;
+public:
+    CoprocCommand(const char *cmd_line, JobsList &jobs) : BuiltInCommand(cmd_line), m_jobsListRef(jobs) {};
+
+    virtual ~CoprocCommand() {}
+
+    void execute() override;
+};
+
+//send name [text]: writes text as one line to the coproc. without text every line of the
+//input is sent and its one line reply printed before the next is sent
+class SendCommand : public BuiltInCommand {
+public:
+    SendCommand(const char *cmd_line) : BuiltInCommand(cmd_line) {};
+
+    virtual ~SendCommand() {}
+
+    void execute() override;
+};
+
+//receive name [count]: prints the next count (1) lines the coproc wrote
+class ReceiveCommand : public BuiltInCommand {
+public:
+    ReceiveCommand(const char *cmd_line) : BuiltInCommand(cmd_line) {};
+
+    virtual ~ReceiveCommand() {}
+
+    void execute() override;
+};
+
+//stats [on | off | -r]
+class StatsCommand : public BuiltInCommand {
+public:
+    StatsCommand(const char *cmd_line) : BuiltInCommand(cmd_line) {};
+
+    virtual ~StatsCommand() {}
+
+    void execute() override;
+};
+
+//jobq [on [N] | off | first <id> | last <id> | drop <id>]
+class JobQueueCommand : public BuiltInCommand {
+    JobsList &m_jobsListRef;
+public:
+    JobQueueCommand(const char *cmd_line, JobsList &jobs) : BuiltInCommand(cmd_line), m_jobsListRef(jobs) {};
+
+    virtual ~JobQueueCommand() {}
+
+    void execute() override;
+};
+
+//history
+class HistoryCommand : public BuiltInCommand {
+public:
+    HistoryCommand(const char *cmd_line) : BuiltInCommand(cmd_line) {};
+
+    virtual ~HistoryCommand() {
+    }
+
+    void execute() override;
+};
+
+//parsecache
+class ParseCacheCommand : public BuiltInCommand {
+public:
+    ParseCacheCommand(const char *cmd_line) : BuiltInCommand(cmd_line) {};
+
+    virtual ~ParseCacheCommand() {
+    }
+
+    void execute() override;
+};
+
+//pipesize
+class PipeSizeCommand : public BuiltInCommand {
+public:
+    PipeSizeCommand(const char *cmd_line) : BuiltInCommand(cmd_line) {};
+
+    virtual ~PipeSizeCommand() {
+    }
+
+    void execute() override;
+};
+
+
 //Special Commands
 class RedirectionCommand : public Command {
-    bool m_override;
-    std::string m_commandPart;
-    std::string m_outPathPart;
+    const char *m_commandPart;
+    const char *m_formatError;      //what parseRedirections found wrong, nullptr if nothing
 public:
-    explicit RedirectionCommand(const std::string cmd_line);
+    explicit RedirectionCommand(const char *cmd_line);
 
     virtual ~RedirectionCommand() {}
 
+    bool needsShellThread() const override;
+
     void execute() override;
 };
 
 class PipeCommand : public Command {
-    std::string m_leftCmd;
-    std::string m_rightCmd;
+    const char *m_leftCmd;
+    const char *m_rightCmd;
     bool m_toStderr;
+    int m_pipeSize;         //from "|[1M]", 0 = shell default
 public:
-    PipeCommand(const std::string cmd_line);
+    PipeCommand(const char *cmd_line);
 
     virtual ~PipeCommand() {}
 
@@ -327,7 +1101,7 @@ public:
 
 class DiskUsageCommand : public Command {
 public:
-    DiskUsageCommand(const std::string cmd_line) : Command(cmd_line) {};
+    DiskUsageCommand(const char *cmd_line) : Command(cmd_line) {};
 
     virtual ~DiskUsageCommand() {}
 
@@ -336,7 +1110,7 @@ public:
 
 class WhoAmICommand : public Command {
 public:
-    WhoAmICommand(const std::string cmd_line) : Command(cmd_line) {};
+    WhoAmICommand(const char *cmd_line) : Command(cmd_line) {};
 
     virtual ~WhoAmICommand() {}
 
@@ -345,11 +1119,24 @@ public:
 
 class NetInfo : public Command {
 public:
-    NetInfo(const std::string cmd_line) : Command(cmd_line) {};
+    NetInfo(const char *cmd_line) : Command(cmd_line) {};
 
     virtual ~NetInfo() {}
 
     void execute() override;
 };
 
+//helpers Commands.cpp shares with bench/smash_bench.cpp
+std::string _trim(const std::string &s);
+
+int parseCommandLine(const std::string &cmd_line, std::vector<std::string> *argsVector);
+
+std::string removeBackgroundSign(const std::string cmd_line);
+
+//du: size of everything under path in KB
+long recursiveFolderSizeCalc(const std::string &path, const bool isBasePath = false);
+
+//utime and stime (clock ticks) from a /proc/<pid>/stat line
+bool parseUtimeStime(const std::string &statLine, unsigned long long &utime, unsigned long long &stime);
+
 #endif //SMASH_COMMAND_H_
@@ -0,0 +1,260 @@
+#include "DirIndex.h"
+#include "Commands.h"
+#include <unistd.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+
+#define DIR_INDEX_MAGIC "SMASHZ1"
+#define DIR_INDEX_INITIAL_CAPACITY (1024)
+//total rank at which every rank is scaled down and the ones under 1 forgotten (z does the same)
+#define DIR_INDEX_AGING_LIMIT (50000.0)
+
+static_assert(sizeof(DirRecord) == 256, "DirRecord must stay 256 bytes");
+static_assert(sizeof(DirIndexHeader) == 256, "the header is one record long");
+
+static uint64_t pathHash(const char *path, size_t length) {
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < length; ++i) hash = (hash ^ (uint8_t) path[i]) * 1099511628211ull;
+    return hash;
+}
+
+DirIndex::~DirIndex() {
+    if (m_map != nullptr) munmap(m_map, m_mapSize);
+    if (m_fd != -1) close(m_fd);
+}
+
+DirIndexHeader *DirIndex::header() const {
+    return (DirIndexHeader *) m_map;
+}
+
+DirRecord *DirIndex::table() const {
+    return (DirRecord *) (m_map + sizeof(DirIndexHeader));
+}
+
+void DirIndex::open() {
+    if (m_opened) return;
+    m_opened = true;
+    const char *path = getenv("SMASH_DIRFILE");
+    if (path != nullptr) {
+        m_path = path;
+    } else if ((path = getenv("HOME")) != nullptr) {
+        m_path = std::string(path) + "/.smash_dirs";
+    } else {
+        return;
+    }
+    m_fd = ::open(m_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (m_fd == -1) {
+        smashErr() << "smash error: z: open failed: " << strerror(errno) << std::endl;
+        return;
+    }
+    struct stat st;
+    if (!lock(LOCK_EX)) return;
+    if (m_map == nullptr && fstat(m_fd, &st) == 0 && st.st_size == 0) {
+        //a new file: the first instance to get the lock formats it
+        rebuild(DIR_INDEX_INITIAL_CAPACITY, 1);
+    }
+    unlock();
+}
+
+//flock + follow a table another instance grew. false if there is no table to read
+//(LOCK_SH); LOCK_EX succeeds without one, so open() can format a new file
+bool DirIndex::lock(int operation) {
+    if (m_fd == -1 || flock(m_fd, operation) == -1) return false;
+    struct stat st;
+    if (fstat(m_fd, &st) == -1) {
+        unlock();
+        return false;
+    }
+    size_t size = st.st_size;
+    if (size < sizeof(DirIndexHeader)) size = 0;
+    if (size != m_mapSize) {
+        if (m_map != nullptr) munmap(m_map, m_mapSize);
+        m_map = nullptr;
+        m_mapSize = 0;
+        void *map = size ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0) : MAP_FAILED;
+        if (map != MAP_FAILED) {
+            m_map = (char *) map;
+            m_mapSize = size;
+        }
+    }
+    if (m_map != nullptr && (memcmp(header()->m_magic, DIR_INDEX_MAGIC, 8) != 0 ||
+                             m_mapSize != sizeof(DirIndexHeader) + (size_t) header()->m_capacity * sizeof(DirRecord))) {
+        //not ours, or cut short. open() formats an empty file, everything else is left alone
+        munmap(m_map, m_mapSize);
+        m_map = nullptr;
+        m_mapSize = 0;
+    }
+    if (operation != LOCK_EX && m_map == nullptr) {
+        unlock();
+        return false;
+    }
+    return true;
+}
+
+void DirIndex::unlock() {
+    flock(m_fd, LOCK_UN);
+}
+
+//the slot holding path, or the free slot where it belongs
+DirRecord *DirIndex::findSlot(const char *path, size_t length) const {
+    uint32_t capacity = header()->m_capacity;
+    for (uint32_t slot = pathHash(path, length) & (capacity - 1);; slot = (slot + 1) & (capacity - 1)) {
+        DirRecord *record = &table()[slot];
+        if (record->m_length == 0 || (record->m_length == length && memcmp(record->m_path, path, length) == 0)) {
+            return record;
+        }
+    }
+}
+
+//resizes the table (or creates it) and reinserts every record with its rank scaled. called under LOCK_EX
+void DirIndex::rebuild(uint32_t capacity, double scale) {
+    std::vector<DirRecord> records;
+    if (m_map != nullptr) {
+        for (uint32_t i = 0; i < header()->m_capacity; ++i) {
+            DirRecord record = table()[i];
+            record.m_rank *= scale;
+            if (record.m_length != 0 && record.m_rank >= 1) records.push_back(record);
+        }
+        munmap(m_map, m_mapSize);
+        m_map = nullptr;
+    }
+    size_t size = sizeof(DirIndexHeader) + (size_t) capacity * sizeof(DirRecord);
+    if (ftruncate(m_fd, 0) == -1 || ftruncate(m_fd, size) == -1) {
+        m_mapSize = 0;
+        return;
+    }
+    void *map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (map == MAP_FAILED) {
+        m_mapSize = 0;
+        return;
+    }
+    m_map = (char *) map;
+    m_mapSize = size;
+    memcpy(header()->m_magic, DIR_INDEX_MAGIC, 8);
+    header()->m_capacity = capacity;
+    header()->m_count = records.size();
+    header()->m_totalRank = 0;
+    ++header()->m_generation;
+    for (const DirRecord &record: records) {
+        *findSlot(record.m_path, record.m_length) = record;
+        header()->m_totalRank += record.m_rank;
+    }
+}
+
+void DirIndex::visit(const std::string &path) {
+    open();
+    if (path.empty() || path.size() > DIR_INDEX_PATH_MAX || !lock(LOCK_EX)) return;
+    if (m_map == nullptr) {
+        unlock();
+        return;
+    }
+    DirRecord *record = findSlot(path.data(), path.size());
+    if (record->m_length == 0) {
+        if ((header()->m_count + 1) * 10 > header()->m_capacity * 7) {
+            rebuild(header()->m_capacity * 2, 1);
+            if (m_map == nullptr) {
+                unlock();
+                return;
+            }
+            record = findSlot(path.data(), path.size());
+        }
+        memset(record, 0, sizeof(DirRecord));
+        memcpy(record->m_path, path.data(), path.size());
+        record->m_length = path.size();
+        ++header()->m_count;
+        //our own insert keeps the packed paths current, another instance's forces a resync
+        if (header()->m_generation++ == m_pathsGeneration) {
+            addPath(path.data(), path.size(), record - table());
+            m_pathsGeneration = header()->m_generation;
+        }
+    }
+    record->m_rank += 1;
+    record->m_lastVisit = time(nullptr);
+    header()->m_totalRank += 1;
+    if (header()->m_totalRank > DIR_INDEX_AGING_LIMIT) rebuild(header()->m_capacity, 0.9);
+    unlock();
+}
+
+//z's weighting: a visit counts more the more recent it is
+static double frecency(const DirRecord &record, int64_t now) {
+    int64_t age = now - record.m_lastVisit;
+    if (age < 3600) return record.m_rank * 4;
+    if (age < 86400) return record.m_rank * 2;
+    if (age < 604800) return record.m_rank / 2;
+    return record.m_rank / 4;
+}
+
+void DirIndex::addPath(const char *path, size_t length, uint32_t slot) {
+    m_pathStarts.push_back(m_paths.size());
+    m_pathSlots.push_back(slot);
+    m_paths.append(path, length);
+    m_paths.push_back('\0');
+}
+
+void DirIndex::syncPaths() {
+    if (header()->m_generation == m_pathsGeneration) return;
+    m_paths.clear();
+    m_pathStarts.clear();
+    m_pathSlots.clear();
+    for (uint32_t i = 0; i < header()->m_capacity; ++i) {
+        const DirRecord &record = table()[i];
+        if (record.m_length != 0) addPath(record.m_path, record.m_length, i);
+    }
+    m_pathsGeneration = header()->m_generation;
+}
+
+//the terms appear in this path in order
+bool DirIndex::matchEntry(size_t entry, const std::vector<std::string> &terms, bool ignoreCase) const {
+    const char *path = m_paths.c_str() + m_pathStarts[entry];
+    for (const std::string &term: terms) {
+        const char *found = ignoreCase ? strcasestr(path, term.c_str()) : strstr(path, term.c_str());
+        if (found == nullptr) return false;
+        path = found + term.size();
+    }
+    return true;
+}
+
+void DirIndex::match(const std::vector<std::string> &terms, std::vector<std::pair<double, std::string>> &matches) {
+    matches.clear();
+    open();
+    if (!lock(LOCK_SH)) return;
+    syncPaths();
+    std::vector<size_t> entries;
+    if (!terms.empty() && !terms[0].empty()) {
+        //one memmem over all the paths finds the first term, the rest is checked per hit
+        const char *paths = m_paths.data();
+        size_t size = m_paths.size();
+        const std::string &first = terms[0];
+        size_t pos = 0;
+        const void *found;
+        while ((found = memmem(paths + pos, size - pos, first.data(), first.size())) != nullptr) {
+            size_t entry = std::upper_bound(m_pathStarts.begin(), m_pathStarts.end(),
+                                            (uint32_t) ((const char *) found - paths)) - m_pathStarts.begin() - 1;
+            if (matchEntry(entry, terms, false)) entries.push_back(entry);
+            pos = entry + 1 < m_pathStarts.size() ? m_pathStarts[entry + 1] : size;
+        }
+    }
+    if (entries.empty()) {
+        //no terms, or nothing matched with case: z then tries ignoring case
+        for (size_t entry = 0; entry < m_pathStarts.size(); ++entry) {
+            if (matchEntry(entry, terms, !terms.empty())) entries.push_back(entry);
+        }
+    }
+    int64_t now = time(nullptr);
+    for (size_t entry: entries) {
+        const DirRecord &record = table()[m_pathSlots[entry]];
+        matches.push_back({frecency(record, now), std::string(record.m_path, record.m_length)});
+    }
+    unlock();
+    std::sort(matches.begin(), matches.end(), [](const std::pair<double, std::string> &a,
+                                                  const std::pair<double, std::string> &b) {
+        return a.first > b.first;
+    });
+}
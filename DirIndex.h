@@ -0,0 +1,82 @@
+#ifndef SMASH_DIR_INDEX_H_
+#define SMASH_DIR_INDEX_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#define DIR_INDEX_PATH_MAX (237)
+
+//one visited directory. 256 bytes, so a record never straddles two pages
+struct DirRecord {
+    double m_rank;              //+1 per visit, scaled down when the database ages
+    int64_t m_lastVisit;        //time()
+    uint16_t m_length;          //0 = free slot
+    char m_path[DIR_INDEX_PATH_MAX + 1];
+};
+
+struct DirIndexHeader {
+    char m_magic[8];
+    uint32_t m_capacity;        //slots, a power of two
+    uint32_t m_count;
+    double m_totalRank;
+    uint64_t m_generation;      //bumped whenever a path is added or the table is rebuilt
+    char m_padding[256 - 8 - 4 - 4 - 8 - 8];
+};
+
+//frecency database of the directories cd visited ($SMASH_DIRFILE, default ~/.smash_dirs):
+//a header and an open-addressing table of DirRecords, mapped shared so every smash instance
+//updates the same file. updates take flock(LOCK_EX) and touch one slot. lookups search a
+//packed copy of the paths (refreshed when the header generation moves), so z stays well
+//under a millisecond with tens of thousands of directories.
+class DirIndex {
+    std::string m_path;
+    int m_fd = -1;
+    bool m_opened = false;
+    char *m_map = nullptr;
+    size_t m_mapSize = 0;
+    std::string m_paths;                //every path in the table, NUL-terminated, back to back
+    std::vector<uint32_t> m_pathStarts; //offset of each in m_paths
+    std::vector<uint32_t> m_pathSlots;  //its slot in the table
+    uint64_t m_pathsGeneration = UINT64_MAX;
+
+    void open();
+
+    bool lock(int operation);
+
+    void unlock();
+
+    DirIndexHeader *header() const;
+
+    DirRecord *table() const;
+
+    DirRecord *findSlot(const char *path, size_t length) const;
+
+    void rebuild(uint32_t capacity, double scale);
+
+    void addPath(const char *path, size_t length, uint32_t slot);
+
+    void syncPaths();
+
+    bool matchEntry(size_t entry, const std::vector<std::string> &terms, bool ignoreCase) const;
+
+public:
+    DirIndex() = default;
+
+    DirIndex(DirIndex const &) = delete;
+
+    void operator=(DirIndex const &) = delete;
+
+    ~DirIndex();
+
+    //cd reached path (absolute, as getcwd reports it)
+    void visit(const std::string &path);
+
+    //directories whose path contains all terms in order, with their score, best first.
+    //no terms = every directory
+    void match(const std::vector<std::string> &terms, std::vector<std::pair<double, std::string>> &matches);
+};
+
+#endif //SMASH_DIR_INDEX_H_
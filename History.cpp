@@ -0,0 +1,172 @@
+#include <unistd.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <iostream>
+#include "History.h"
+#include "Commands.h"
+
+History::~History() {
+    if (m_map != nullptr) munmap((void *) m_map, m_mapSize);
+    if (m_writeFd != -1) close(m_writeFd);
+    if (m_readFd != -1) close(m_readFd);
+}
+
+void History::open() {
+    if (m_opened) return;
+    m_opened = true;
+    const char *path = getenv("SMASH_HISTFILE");
+    if (path != nullptr) {
+        m_path = path;
+    } else if ((path = getenv("HOME")) != nullptr) {
+        m_path = std::string(path) + "/.smash_history";
+    } else {
+        return;     //no history, like bash without HOME
+    }
+    m_writeFd = ::open(m_path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+    if (m_writeFd == -1) {
+        smashErr() << "smash error: history: open failed: " << strerror(errno) << std::endl;
+        return;
+    }
+    m_readFd = ::open(m_path.c_str(), O_RDONLY | O_CLOEXEC);
+}
+
+//maps what was appended since the last call (by us or another instance) and splits it into entries
+void History::refresh() {
+    open();
+    struct stat st;
+    if (m_readFd == -1 || fstat(m_readFd, &st) == -1) return;
+    size_t size = st.st_size;
+    if (size < m_mapSize) {
+        //someone truncated the file, start over
+        munmap((void *) m_map, m_mapSize);
+        m_map = nullptr;
+        m_mapSize = m_indexed = m_trigramEntries = 0;
+        m_entries.clear();
+        m_signatures.clear();
+    }
+    if (size == m_mapSize) return;
+    void *map = m_map == nullptr ? mmap(nullptr, size, PROT_READ, MAP_SHARED, m_readFd, 0)
+                                 : mremap((void *) m_map, m_mapSize, size, MREMAP_MAYMOVE);
+    if (map == MAP_FAILED) return;
+    m_map = (const char *) map;
+    m_mapSize = size;
+    //a line another instance is writing right now has no '\n' yet, it is picked up next time
+    const char *newline;
+    while ((newline = (const char *) memchr(m_map + m_indexed, '\n', m_mapSize - m_indexed)) != nullptr) {
+        m_entries.push_back(m_indexed);
+        m_indexed = newline - m_map + 1;
+    }
+}
+
+void History::add(const char *line, size_t length) {
+    open();
+    if (m_writeFd == -1 || length == 0) return;
+    m_record.assign(line, length);
+    m_record.push_back('\n');
+    //one write per entry: O_APPEND keeps concurrent instances from interleaving inside a line
+    if (write(m_writeFd, m_record.data(), m_record.size()) == -1) {
+        smashErr() << "smash error: history: write failed: " << strerror(errno) << std::endl;
+    }
+}
+
+size_t History::size() {
+    refresh();
+    return m_entries.size();
+}
+
+const char *History::at(size_t n, size_t &length) const {
+    if (n == 0 || n > m_entries.size()) return nullptr;
+    size_t start = m_entries[n - 1];
+    size_t end = n < m_entries.size() ? m_entries[n] : m_indexed;
+    length = end - start - 1;
+    return m_map + start;
+}
+
+const char *History::entry(size_t n, size_t &length) {
+    refresh();
+    return at(n, length);
+}
+
+size_t History::findPrefix(const char *prefix, size_t length) {
+    for (size_t n = size(); n > 0; --n) {
+        size_t entryLength;
+        const char *text = at(n, entryLength);
+        if (entryLength >= length && memcmp(text, prefix, length) == 0) return n;
+    }
+    return 0;
+}
+
+#define SIGNATURE_WORDS (HISTORY_SIGNATURE_BITS / 64)
+
+static_assert(HISTORY_SIGNATURE_BITS == 1 << 14, "trigramBit returns 14 bits");
+
+static uint32_t trigramBit(const char *text) {
+    uint32_t trigram = ((uint32_t) (uint8_t) text[0] << 16) | ((uint32_t) (uint8_t) text[1] << 8) | (uint8_t) text[2];
+    return (trigram * 2654435761u) >> 18;     //top 14 bits
+}
+
+void History::indexTrigrams() {
+    refresh();
+    m_signatures.resize((m_entries.size() + HISTORY_BLOCK - 1) / HISTORY_BLOCK * SIGNATURE_WORDS);
+    for (; m_trigramEntries < m_entries.size(); ++m_trigramEntries) {
+        uint64_t *signature = &m_signatures[m_trigramEntries / HISTORY_BLOCK * SIGNATURE_WORDS];
+        size_t length;
+        const char *text = at(m_trigramEntries + 1, length);
+        for (size_t i = 0; i + 3 <= length; ++i) {
+            uint32_t bit = trigramBit(text + i);
+            signature[bit / 64] |= 1ull << (bit % 64);
+        }
+    }
+}
+
+void History::search(const char *text, size_t length, std::vector<size_t> &matches) {
+    matches.clear();
+    std::vector<uint32_t> bits;
+    if (length >= 3) {
+        indexTrigrams();
+        for (size_t i = 0; i + 3 <= length; ++i) bits.push_back(trigramBit(text + i));
+    } else {
+        refresh();      //too short for the index: every block is a candidate
+    }
+    size_t blocks = (m_entries.size() + HISTORY_BLOCK - 1) / HISTORY_BLOCK;
+    for (size_t block = blocks; block-- > 0;) {
+        const uint64_t *signature = bits.empty() ? nullptr : &m_signatures[block * SIGNATURE_WORDS];
+        bool candidate = true;
+        for (size_t i = 0; candidate && i < bits.size(); ++i) {
+            candidate = signature[bits[i] / 64] & (1ull << (bits[i] % 64));
+        }
+        if (!candidate) continue;
+        //a block with every trigram of the text, look at its entries
+        size_t first = block * HISTORY_BLOCK + 1;
+        for (size_t n = std::min(first + HISTORY_BLOCK - 1, m_entries.size()); n >= first; --n) {
+            size_t entryLength;
+            const char *line = at(n, entryLength);
+            if (memmem(line, entryLength, text, length) != nullptr) matches.push_back(n);
+        }
+    }
+}
+
+bool History::expand(const char *line, std::string &expanded) {
+    const char *event = line + 1;
+    size_t eventLength = 0;
+    while (event[eventLength] != '\0' && !isspace((unsigned char) event[eventLength])) ++eventLength;
+    size_t n;
+    if (eventLength == 1 && event[0] == '!') {
+        n = size();                                             //!!
+    } else if (eventLength > 0 && strspn(event, "0123456789") == eventLength) {
+        n = strtoul(event, nullptr, 10);                        //!n
+    } else {
+        n = findPrefix(event, eventLength);                     //!prefix
+    }
+    size_t length;
+    const char *text = entry(n, length);
+    if (text == nullptr) return false;
+    expanded.assign(text, length);
+    expanded.append(event + eventLength);
+    return true;
+}
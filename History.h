@@ -0,0 +1,67 @@
+#ifndef SMASH_HISTORY_H_
+#define SMASH_HISTORY_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define HISTORY_BLOCK (256)
+#define HISTORY_SIGNATURE_BITS (1 << 14)
+
+//command history in an append-only file ($SMASH_HISTFILE, default ~/.smash_history), one line
+//per entry. every entry is a single O_APPEND write, so several smash instances can share the
+//file. reading maps it instead of parsing it: nothing is touched until the history is used,
+//and then only the bytes appended since the last use are scanned.
+class History {
+    std::string m_path;
+    int m_writeFd = -1;
+    int m_readFd = -1;
+    bool m_opened = false;
+    const char *m_map = nullptr;
+    size_t m_mapSize = 0;
+    size_t m_indexed = 0;                   //bytes of the map split into m_entries
+    std::vector<size_t> m_entries;          //start offset of every complete line
+    std::string m_record;                   //reused by add()
+    //trigram index: per block of HISTORY_BLOCK entries, a bitmap of the hashed trigrams in it.
+    //built on the first search and extended by the next ones, 8MB for a million entries
+    std::vector<uint64_t> m_signatures;
+    size_t m_trigramEntries = 0;
+
+    void open();
+
+    void refresh();
+
+    //entry n as of the last refresh()
+    const char *at(size_t n, size_t &length) const;
+
+    void indexTrigrams();
+
+public:
+    History() = default;
+
+    History(History const &) = delete;
+
+    void operator=(History const &) = delete;
+
+    ~History();
+
+    void add(const char *line, size_t length);
+
+    //number of entries, including the ones other instances appended
+    size_t size();
+
+    //entry n, 1-based. nullptr if there is none
+    const char *entry(size_t n, size_t &length);
+
+    //the newest entry starting with prefix, 0 if none
+    size_t findPrefix(const char *prefix, size_t length);
+
+    //entries containing text, newest first
+    void search(const char *text, size_t length, std::vector<size_t> &matches);
+
+    //"!n args" / "!prefix args" -> the entry followed by args. false if the event is not found
+    bool expand(const char *line, std::string &expanded);
+};
+
+#endif //SMASH_HISTORY_H_
@@ -0,0 +1,341 @@
+#include "LineEditor.h"
+#include "Commands.h"
+#include "signals.h"
+#include <unistd.h>
+#include <string.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <termios.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <iostream>
+
+//--------------------EXECUTABLE INDEX--------------------//
+#pragma region EXECUTABLE INDEX
+
+ExecutableIndex::~ExecutableIndex() {
+    if (m_inotifyFd != -1) close(m_inotifyFd);
+}
+
+void ExecutableIndex::build() {
+    const char *path = getenv("PATH");
+    m_pathVar = path ? path : "";
+    m_built = true;
+    m_dirs.clear();
+    if (m_inotifyFd != -1) close(m_inotifyFd);     //drops the old watches too
+    m_inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    size_t start = 0;
+    while (start <= m_pathVar.size()) {
+        size_t end = m_pathVar.find(':', start);
+        if (end == std::string::npos) end = m_pathVar.size();
+        std::string dir = m_pathVar.substr(start, end - start);
+        start = end + 1;
+        //relative entries depend on the cwd, execvp still finds them
+        if (dir.empty() || dir[0] != '/') continue;
+        bool seen = false;
+        for (const Directory &other: m_dirs) seen = seen || other.m_path == dir;
+        if (seen) continue;
+        int watch = m_inotifyFd == -1 ? -1 : inotify_add_watch(
+                m_inotifyFd, dir.c_str(), IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB);
+        m_dirs.push_back({dir, watch, {}});
+        scan(m_dirs.back());
+    }
+    merge();
+}
+
+void ExecutableIndex::scan(Directory &dir) {
+    dir.m_names.clear();
+    DIR *stream = opendir(dir.m_path.c_str());
+    if (stream == nullptr) return;
+    struct dirent *entry;
+    while ((entry = readdir(stream)) != nullptr) {
+        if (entry->d_name[0] == '.') continue;
+        struct stat st;
+        if (fstatat(dirfd(stream), entry->d_name, &st, 0) == 0 && S_ISREG(st.st_mode) &&
+            faccessat(dirfd(stream), entry->d_name, X_OK, 0) == 0) {
+            dir.m_names.push_back(entry->d_name);
+        }
+    }
+    closedir(stream);
+}
+
+void ExecutableIndex::merge() {
+    m_names.clear();
+    for (const Directory &dir: m_dirs) m_names.insert(m_names.end(), dir.m_names.begin(), dir.m_names.end());
+    std::sort(m_names.begin(), m_names.end());
+    m_names.erase(std::unique(m_names.begin(), m_names.end()), m_names.end());
+}
+
+//rescans only the directories inotify reported since the last call
+void ExecutableIndex::update() {
+    const char *path = getenv("PATH");
+    if (!m_built || m_pathVar != (path ? path : "")) {
+        build();
+        return;
+    }
+    if (m_inotifyFd == -1) return;
+    std::vector<int> changed;
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t length;
+    while ((length = read(m_inotifyFd, buffer, sizeof(buffer))) > 0) {
+        for (char *pos = buffer; pos < buffer + length;) {
+            struct inotify_event *event = (struct inotify_event *) pos;
+            if (std::find(changed.begin(), changed.end(), event->wd) == changed.end()) {
+                changed.push_back(event->wd);
+            }
+            pos += sizeof(struct inotify_event) + event->len;
+        }
+    }
+    if (changed.empty()) return;
+    for (Directory &dir: m_dirs) {
+        if (std::find(changed.begin(), changed.end(), dir.m_watch) != changed.end()) scan(dir);
+    }
+    merge();
+}
+
+void ExecutableIndex::complete(const std::string &prefix, std::vector<std::string> &matches) {
+    update();
+    for (auto iter = std::lower_bound(m_names.begin(), m_names.end(), prefix);
+         iter != m_names.end() && iter->compare(0, prefix.size(), prefix) == 0; ++iter) {
+        matches.push_back(*iter);
+    }
+}
+
+#pragma endregion
+
+//--------------------LINE EDITOR--------------------//
+#pragma region LINE EDITOR
+
+static void writeTerminal(const std::string &text) {
+    size_t done = 0;
+    while (done < text.size()) {
+        ssize_t written = write(STDOUT_FILENO, text.data() + done, text.size() - done);
+        if (written == -1 && errno == EINTR) continue;
+        if (written <= 0) return;
+        done += written;
+    }
+}
+
+//one write per key: back to the start of the line, prompt, text, clear the rest, cursor back
+void LineEditor::redraw() {
+    std::string out = "\r" + m_prompt + m_line + "\x1b[K";
+    if (m_cursor < m_line.size()) out += "\x1b[" + std::to_string(m_line.size() - m_cursor) + "D";
+    writeTerminal(out);
+}
+
+void LineEditor::showHistory(size_t n) {
+    History &history = SmallShell::getInstance().getHistory();
+    size_t length;
+    const char *text = history.entry(n, length);
+    m_historyPos = n;
+    m_line = text ? std::string(text, length) : m_editedLine;
+    m_cursor = m_line.size();
+    redraw();
+}
+
+void LineEditor::complete() {
+    size_t start = m_cursor;
+    while (start > 0 && !isspace((unsigned char) m_line[start - 1])) --start;
+    std::string word = m_line.substr(start, m_cursor - start);
+    //a command name: the first word, or the first one after a pipe
+    size_t before = start == 0 ? std::string::npos : m_line.find_last_not_of(" \t", start - 1);
+    bool isCommand = before == std::string::npos || m_line[before] == '|';
+
+    std::vector<std::string> matches;
+    if (isCommand && word.find('/') == std::string::npos) {
+        std::vector<std::string> names;
+        builtinNames(names);
+        for (const auto &alias: SmallShell::getInstance().m_aliasMap) names.push_back(alias.first);
+        for (const std::string &name: names) {
+            if (name.compare(0, word.size(), word) == 0) matches.push_back(name);
+        }
+        m_executables.complete(word, matches);
+    } else {
+        size_t slash = word.rfind('/');
+        std::string dirPart = slash == std::string::npos ? "" : word.substr(0, slash + 1);
+        std::string base = word.substr(dirPart.size());
+        DIR *stream = opendir(dirPart.empty() ? "." : dirPart.c_str());
+        struct dirent *entry;
+        while (stream != nullptr && (entry = readdir(stream)) != nullptr) {
+            std::string name = entry->d_name;
+            if (name == "." || name == ".." || (name[0] == '.' && base.empty())) continue;
+            if (name.compare(0, base.size(), base) != 0) continue;
+            struct stat st;
+            bool isDir = fstatat(dirfd(stream), entry->d_name, &st, 0) == 0 && S_ISDIR(st.st_mode);
+            matches.push_back(dirPart + name + (isDir ? "/" : ""));
+        }
+        if (stream != nullptr) closedir(stream);
+    }
+    std::sort(matches.begin(), matches.end());
+    matches.erase(std::unique(matches.begin(), matches.end()), matches.end());
+    if (matches.empty()) {
+        writeTerminal("\a");
+        return;
+    }
+
+    size_t common = matches[0].size();
+    for (const std::string &match: matches) {
+        size_t i = 0;
+        while (i < common && i < match.size() && match[i] == matches[0][i]) ++i;
+        common = i;
+    }
+    if (common > word.size() || matches.size() == 1) {
+        std::string insert = matches[0].substr(word.size(), common - word.size());
+        if (matches.size() == 1 && matches[0].back() != '/') insert += ' ';
+        m_line.insert(m_cursor, insert);
+        m_cursor += insert.size();
+        m_listOnTab = false;
+        redraw();
+        return;
+    }
+    if (!m_listOnTab) {
+        //ambiguous: beep now, list on the second tab
+        m_listOnTab = true;
+        writeTerminal("\a");
+        return;
+    }
+    std::string list = "\n";     //OPOST stays on, the terminal adds the \r
+    for (const std::string &match: matches) list += match.substr(match.rfind('/', match.size() - 2) + 1) + "  ";
+    writeTerminal(list + "\n");
+    redraw();
+}
+
+//blocks until a key is ready. meanwhile jobs are reaped, started and timed out as it happens
+static void waitInput() {
+    SmallShell &smash = SmallShell::getInstance();
+    std::vector<int> events;
+    std::vector<struct pollfd> fds;
+    while (true) {
+        events.clear();
+        smash.jobEventFds(events);
+        if (events.empty()) return;
+        fds.assign(1, {STDIN_FILENO, POLLIN, 0});
+        for (int fd: events) fds.push_back({fd, POLLIN, 0});
+        if (poll(fds.data(), fds.size(), -1) == -1 && errno != EINTR) return;
+        if (fds[0].revents) return;
+        for (size_t i = 1; i < fds.size(); i++) {
+            if (fds[i].revents) {
+                smash.serviceJobs();
+                break;
+            }
+        }
+    }
+}
+
+bool LineEditor::readLine(const std::string &prompt, std::string &line) {
+    struct termios saved;
+    if (!isatty(STDIN_FILENO) || tcgetattr(STDIN_FILENO, &saved) == -1) {
+        //stdin is shared with built-ins reading it, so no polling here: jobs are serviced per line
+        if (childEventFd() != -1) SmallShell::getInstance().serviceJobs();
+        return (bool) std::getline(std::cin, line);
+    }
+    struct termios raw = saved;
+    raw.c_lflag &= ~(ICANON | ECHO | ISIG | IEXTEN);
+    raw.c_iflag &= ~(IXON | ICRNL);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    tcsetattr(STDIN_FILENO, TCSADRAIN, &raw);
+
+    m_prompt = prompt;
+    m_line.clear();
+    m_cursor = 0;
+    m_historyPos = SmallShell::getInstance().getHistory().size() + 1;
+    m_listOnTab = false;
+    bool gotLine = true;
+    bool interrupted = false;
+    while (true) {
+        char c;
+        waitInput();
+        ssize_t got = read(STDIN_FILENO, &c, 1);
+        if (got == -1 && errno == EINTR) continue;
+        if (got <= 0) {
+            gotLine = false;
+            break;
+        }
+        bool tab = c == '\t';
+        if (c == '\r' || c == '\n') {
+            break;
+        } else if (c == 3) {                                        //ctrl-C: drop the line
+            interrupted = true;
+            m_line.clear();
+            break;
+        } else if (c == 4) {                                        //ctrl-D: EOF on an empty line
+            if (m_line.empty()) {
+                gotLine = false;
+                break;
+            }
+            if (m_cursor < m_line.size()) m_line.erase(m_cursor, 1);
+        } else if (c == 127 || c == 8) {                            //backspace
+            if (m_cursor > 0) m_line.erase(--m_cursor, 1);
+        } else if (c == 1) {                                        //ctrl-A
+            m_cursor = 0;
+        } else if (c == 5) {                                        //ctrl-E
+            m_cursor = m_line.size();
+        } else if (c == 11) {                                       //ctrl-K
+            m_line.erase(m_cursor);
+        } else if (c == 21) {                                       //ctrl-U
+            m_line.erase(0, m_cursor);
+            m_cursor = 0;
+        } else if (c == 23) {                                       //ctrl-W
+            size_t start = m_cursor;
+            while (start > 0 && isspace((unsigned char) m_line[start - 1])) --start;
+            while (start > 0 && !isspace((unsigned char) m_line[start - 1])) --start;
+            m_line.erase(start, m_cursor - start);
+            m_cursor = start;
+        } else if (c == 12) {                                       //ctrl-L
+            writeTerminal("\x1b[H\x1b[2J");
+        } else if (tab) {
+            complete();
+            continue;
+        } else if (c == 27) {                                       //escape sequence
+            char seq[3] = {0, 0, 0};
+            if (read(STDIN_FILENO, seq, 1) != 1 || read(STDIN_FILENO, seq + 1, 1) != 1) continue;
+            if (seq[0] == '[' && isdigit((unsigned char) seq[1])) {
+                if (read(STDIN_FILENO, seq + 2, 1) != 1 || seq[2] != '~') continue;
+                if (seq[1] == '3' && m_cursor < m_line.size()) m_line.erase(m_cursor, 1);
+                if (seq[1] == '1' || seq[1] == '7') m_cursor = 0;
+                if (seq[1] == '4' || seq[1] == '8') m_cursor = m_line.size();
+            } else if (seq[0] == '[' || seq[0] == 'O') {
+                History &history = SmallShell::getInstance().getHistory();
+                switch (seq[1]) {
+                    case 'A':
+                        if (m_historyPos == history.size() + 1) m_editedLine = m_line;
+                        if (m_historyPos > 1) showHistory(m_historyPos - 1);
+                        continue;
+                    case 'B':
+                        if (m_historyPos <= history.size()) showHistory(m_historyPos + 1);
+                        continue;
+                    case 'C':
+                        if (m_cursor < m_line.size()) ++m_cursor;
+                        break;
+                    case 'D':
+                        if (m_cursor > 0) --m_cursor;
+                        break;
+                    case 'H':
+                        m_cursor = 0;
+                        break;
+                    case 'F':
+                        m_cursor = m_line.size();
+                        break;
+                }
+            }
+        } else if ((unsigned char) c >= 32) {
+            m_line.insert(m_cursor++, 1, c);
+        }
+        m_listOnTab = false;
+        redraw();
+    }
+
+    writeTerminal(interrupted ? "^C\n" : "\n");
+    tcsetattr(STDIN_FILENO, TCSADRAIN, &saved);
+    if (interrupted) raise(SIGINT);     //the ctrl-C handler reports it, as when reading in cooked mode
+    line = m_line;
+    return gotLine;
+}
+
+#pragma endregion
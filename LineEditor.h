@@ -0,0 +1,72 @@
+#ifndef SMASH_LINE_EDITOR_H_
+#define SMASH_LINE_EDITOR_H_
+
+#include <string>
+#include <vector>
+
+//every executable file in the PATH directories, sorted, for completion. it is built on the
+//first use; after that an inotify watch on each directory tells which ones to rescan, so a
+//lookup never walks PATH again unless PATH itself changed.
+class ExecutableIndex {
+    struct Directory {
+        std::string m_path;
+        int m_watch;
+        std::vector<std::string> m_names;
+    };
+
+    std::string m_pathVar;              //PATH the index was built from
+    bool m_built = false;
+    int m_inotifyFd = -1;
+    std::vector<Directory> m_dirs;
+    std::vector<std::string> m_names;   //all of m_dirs merged, sorted, unique
+
+    void build();
+
+    void scan(Directory &dir);
+
+    void merge();
+
+    void update();
+
+public:
+    ExecutableIndex() = default;
+
+    ExecutableIndex(ExecutableIndex const &) = delete;
+
+    void operator=(ExecutableIndex const &) = delete;
+
+    ~ExecutableIndex();
+
+    //appends the executables starting with prefix
+    void complete(const std::string &prefix, std::vector<std::string> &matches);
+};
+
+//reads one line. on a terminal: raw mode with cursor movement, history on up/down and tab
+//completion of built-ins, aliases, PATH executables and file names. otherwise a plain getline.
+class LineEditor {
+    std::string m_prompt;
+    std::string m_line;
+    size_t m_cursor = 0;
+    size_t m_historyPos = 0;            //entry shown by up/down, history size + 1 = the new line
+    std::string m_editedLine;           //the new line while browsing history
+    bool m_listOnTab = false;           //the previous key was a tab that could not complete
+    ExecutableIndex m_executables;
+
+    void redraw();
+
+    void complete();
+
+    void showHistory(size_t n);
+
+public:
+    LineEditor() = default;
+
+    LineEditor(LineEditor const &) = delete;
+
+    void operator=(LineEditor const &) = delete;
+
+    //false on end of input
+    bool readLine(const std::string &prompt, std::string &line);
+};
+
+#endif //SMASH_LINE_EDITOR_H_
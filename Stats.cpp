@@ -0,0 +1,122 @@
+#include "Stats.h"
+#include <time.h>
+#include <algorithm>
+#include <cstdio>
+#include <string>
+
+std::atomic<bool> g_statsOn(false);
+
+//one HDR-style histogram: values below STAT_SUB_BUCKETS exactly, then every power of two
+//split into STAT_SUB_BUCKETS linear buckets. counters are relaxed atomics since pipeline
+//stage threads spawn too
+struct StatHistogram {
+    std::atomic<uint32_t> m_buckets[STAT_BUCKETS];
+    std::atomic<uint64_t> m_count;
+    std::atomic<uint64_t> m_max;
+};
+
+static const char *const PHASE_NAMES[STAT_PHASES] = {"parse", "fork", "exec", "wait", "reap", "total"};
+static const char *const KIND_NAMES[STAT_KINDS] = {"builtin", "redirection", "pipe", "external"};
+
+static std::atomic<StatHistogram *> s_histograms(nullptr);    //[phase][kind], set once
+static std::atomic<int> s_kind(STAT_BUILTIN);
+
+static size_t bucketOf(uint64_t value) {
+    if (value < STAT_SUB_BUCKETS) return value;
+    int exponent = 63 - __builtin_clzll(value);
+    return (exponent - 3) * STAT_SUB_BUCKETS + ((value >> (exponent - 4)) & (STAT_SUB_BUCKETS - 1));
+}
+
+//the largest value that lands in bucket
+static uint64_t bucketTop(size_t bucket) {
+    if (bucket < STAT_SUB_BUCKETS) return bucket;
+    int exponent = bucket / STAT_SUB_BUCKETS + 3;
+    uint64_t step = 1ull << (exponent - 4);
+    return (STAT_SUB_BUCKETS + bucket % STAT_SUB_BUCKETS) * step + step - 1;
+}
+
+static uint64_t percentile(const StatHistogram &histogram, uint64_t count, double fraction) {
+    uint64_t rank = (uint64_t) (fraction * count + 0.999999);
+    if (rank == 0) rank = 1;
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < STAT_BUCKETS; bucket++) {
+        seen += histogram.m_buckets[bucket].load(std::memory_order_relaxed);
+        if (seen >= rank) return bucketTop(bucket);
+    }
+    return 0;
+}
+
+static std::string formatNanoseconds(uint64_t nanoseconds) {
+    char text[32];
+    if (nanoseconds < 1000) snprintf(text, sizeof(text), "%lluns", (unsigned long long) nanoseconds);
+    else if (nanoseconds < 1000000) snprintf(text, sizeof(text), "%.1fus", nanoseconds / 1e3);
+    else if (nanoseconds < 1000000000) snprintf(text, sizeof(text), "%.1fms", nanoseconds / 1e6);
+    else snprintf(text, sizeof(text), "%.2fs", nanoseconds / 1e9);
+    return text;
+}
+
+uint64_t statClock() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+void statAdd(StatPhase phase, StatKind kind, uint64_t nanoseconds) {
+    StatHistogram *histograms = s_histograms.load(std::memory_order_acquire);
+    if (histograms == nullptr) return;
+    StatHistogram &histogram = histograms[phase * STAT_KINDS + kind];
+    histogram.m_buckets[bucketOf(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+    histogram.m_count.fetch_add(1, std::memory_order_relaxed);
+    uint64_t max = histogram.m_max.load(std::memory_order_relaxed);
+    while (nanoseconds > max && !histogram.m_max.compare_exchange_weak(max, nanoseconds,
+                                                                       std::memory_order_relaxed)) {}
+}
+
+void statSetKind(StatKind kind) {
+    s_kind.store(kind, std::memory_order_relaxed);
+}
+
+StatKind statKind() {
+    return (StatKind) s_kind.load(std::memory_order_relaxed);
+}
+
+void statsEnable(bool on) {
+    if (on && s_histograms.load() == nullptr) {
+        s_histograms.store(new StatHistogram[STAT_PHASES * STAT_KINDS](), std::memory_order_release);
+    }
+    g_statsOn.store(on, std::memory_order_relaxed);
+}
+
+void statsReset() {
+    StatHistogram *histograms = s_histograms.load(std::memory_order_acquire);
+    if (histograms == nullptr) return;
+    for (int i = 0; i < STAT_PHASES * STAT_KINDS; i++) {
+        for (auto &bucket: histograms[i].m_buckets) bucket.store(0, std::memory_order_relaxed);
+        histograms[i].m_count.store(0, std::memory_order_relaxed);
+        histograms[i].m_max.store(0, std::memory_order_relaxed);
+    }
+}
+
+void statsPrint(std::ostream &out) {
+    out << "stats: " << (g_statsOn.load() ? "on" : "off") << '\n';
+    StatHistogram *histograms = s_histograms.load(std::memory_order_acquire);
+    if (histograms == nullptr) return;
+    char line[128];
+    snprintf(line, sizeof(line), "%-6s %-12s %8s %9s %9s %9s", "phase", "kind", "count", "p50", "p99", "max");
+    out << line << '\n';
+    for (int phase = 0; phase < STAT_PHASES; phase++) {
+        for (int kind = 0; kind < STAT_KINDS; kind++) {
+            const StatHistogram &histogram = histograms[phase * STAT_KINDS + kind];
+            uint64_t count = histogram.m_count.load(std::memory_order_relaxed);
+            if (count == 0) continue;
+            uint64_t max = histogram.m_max.load(std::memory_order_relaxed);
+            //a bucket's top can be above the largest value in it
+            uint64_t p50 = std::min(percentile(histogram, count, 0.50), max);
+            uint64_t p99 = std::min(percentile(histogram, count, 0.99), max);
+            snprintf(line, sizeof(line), "%-6s %-12s %8llu %9s %9s %9s", PHASE_NAMES[phase], KIND_NAMES[kind],
+                     (unsigned long long) count, formatNanoseconds(p50).c_str(), formatNanoseconds(p99).c_str(),
+                     formatNanoseconds(max).c_str());
+            out << line << '\n';
+        }
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef SMASH_STATS_H_
+#define SMASH_STATS_H_
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+
+//where a command's time goes
+enum StatPhase {
+    STAT_PARSE,     //CreateCommand
+    STAT_FORK,      //fork() in the parent
+    STAT_EXEC,      //fork returned -> the child's exec succeeded
+    STAT_WAIT,      //the foreground command running
+    STAT_REAP,      //wait4 of a finished background job
+    STAT_TOTAL,     //executeCommand
+    STAT_PHASES
+};
+
+//same order as ParsedKind
+enum StatKind {
+    STAT_BUILTIN,
+    STAT_REDIRECTION,
+    STAT_PIPE,
+    STAT_EXTERNAL,
+    STAT_KINDS
+};
+
+#define STAT_SUB_BUCKETS (16)                       //per power of two, values within 6.25%
+#define STAT_BUCKETS (61 * STAT_SUB_BUCKETS)        //every uint64_t nanosecond count
+
+extern std::atomic<bool> g_statsOn;
+
+uint64_t statClock();
+
+//monotonic nanoseconds with stats on, 0 otherwise. the only cost of the instrumentation
+//while stats are off is this load
+inline uint64_t statTime() {
+    return g_statsOn.load(std::memory_order_relaxed) ? statClock() : 0;
+}
+
+void statAdd(StatPhase phase, StatKind kind, uint64_t nanoseconds);
+
+//kind of the command executeCommand is running, for the phases measured deeper down
+void statSetKind(StatKind kind);
+
+StatKind statKind();
+
+//records the time since start, a statTime(). nothing if stats were off then
+inline void statRecord(StatPhase phase, StatKind kind, uint64_t start) {
+    if (start != 0) statAdd(phase, kind, statClock() - start);
+}
+
+inline void statRecord(StatPhase phase, uint64_t start) {
+    if (start != 0) statAdd(phase, statKind(), statClock() - start);
+}
+
+//stats on / off. the histograms are allocated the first time
+void statsEnable(bool on);
+
+void statsReset();
+
+//count, p50, p99 and max of every phase and kind seen
+void statsPrint(std::ostream &out);
+
+#endif //SMASH_STATS_H_
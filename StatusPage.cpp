@@ -0,0 +1,101 @@
+#include "StatusPage.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cstdlib>
+#include <cstring>
+
+static_assert(sizeof(StatusJob) == 192, "StatusJob is part of the file format");
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && sizeof(std::atomic<uint64_t>) == 8,
+              "the sequence is shared between processes");
+
+#define SNAPSHOT_ATTEMPTS (1000)
+
+StatusPage::~StatusPage() {
+    remove();
+}
+
+std::string StatusPage::pathFor(pid_t pid) {
+    const char *dir = getenv("SMASH_STATUS_DIR");
+    return std::string(dir != nullptr && *dir != '\0' ? dir : "/dev/shm") + "/smash-" + std::to_string(pid);
+}
+
+bool StatusPage::create(const std::string &path) {
+    remove();
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1) return false;
+    void *map = MAP_FAILED;
+    if (ftruncate(fd, sizeof(StatusPageLayout)) == 0) {
+        map = mmap(nullptr, sizeof(StatusPageLayout), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (map == MAP_FAILED) {
+        unlink(path.c_str());
+        return false;
+    }
+    m_page = static_cast<StatusPageLayout *>(map);
+    m_path = path;
+    m_owner = getpid();
+    //a fresh file is all zeroes: sequence 0, an empty but consistent page
+    memcpy(m_page->m_data.m_magic, STATUS_MAGIC, sizeof(m_page->m_data.m_magic));
+    m_page->m_data.m_size = sizeof(StatusPageLayout);
+    return true;
+}
+
+bool StatusPage::isOpen() const {
+    return m_page != nullptr;
+}
+
+StatusData &StatusPage::data() {
+    return m_page->m_data;
+}
+
+void StatusPage::beginWrite() {
+    m_page->m_sequence.store(m_page->m_sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+void StatusPage::endWrite() {
+    m_page->m_sequence.store(m_page->m_sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void StatusPage::remove() {
+    if (m_page == nullptr) return;
+    munmap(m_page, sizeof(StatusPageLayout));
+    m_page = nullptr;
+    if (getpid() == m_owner) unlink(m_path.c_str());
+}
+
+const StatusPageLayout *StatusPage::map(const std::string &path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return nullptr;
+    struct stat st;
+    void *map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t) st.st_size == sizeof(StatusPageLayout)) {
+        map = mmap(nullptr, sizeof(StatusPageLayout), PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (map == MAP_FAILED) return nullptr;
+    const StatusPageLayout *page = static_cast<const StatusPageLayout *>(map);
+    if (memcmp(page->m_data.m_magic, STATUS_MAGIC, sizeof(page->m_data.m_magic)) != 0) {
+        unmap(page);
+        return nullptr;
+    }
+    return page;
+}
+
+void StatusPage::unmap(const StatusPageLayout *page) {
+    munmap(const_cast<StatusPageLayout *>(page), sizeof(StatusPageLayout));
+}
+
+bool StatusPage::snapshot(const StatusPageLayout *page, StatusData &copy) {
+    for (int attempt = 0; attempt < SNAPSHOT_ATTEMPTS; attempt++) {
+        uint64_t before = page->m_sequence.load(std::memory_order_acquire);
+        if (before & 1) continue;       //a write is in progress
+        memcpy(&copy, &page->m_data, sizeof(copy));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (page->m_sequence.load(std::memory_order_relaxed) == before) return true;
+    }
+    return false;
+}
@@ -0,0 +1,98 @@
+#ifndef SMASH_STATUS_PAGE_H_
+#define SMASH_STATUS_PAGE_H_
+
+#include <sys/types.h>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#define STATUS_MAGIC "SMASHST2"
+#define STATUS_MAX_JOBS (64)
+#define STATUS_COMMAND_MAX (151)
+
+enum StatusJobState {
+    STATUS_RUNNING,
+    STATUS_STOPPED,
+    STATUS_QUEUED,      //jobq: waiting for a free slot
+    STATUS_WAITING      //after: waiting for other jobs
+};
+
+struct StatusJob {
+    int32_t m_jobID;
+    int32_t m_pid;                  //-1 while queued or waiting
+    uint32_t m_state;               //StatusJobState
+    uint32_t m_padding;
+    int64_t m_startTime;            //CLOCK_REALTIME ns
+    int64_t m_userTime;             //CPU time in us, sampled at StatusData::m_cpuSampled
+    int64_t m_systemTime;
+    char m_command[STATUS_COMMAND_MAX + 1];
+};
+
+//everything a reader gets, plain data so a snapshot is a memcpy
+struct StatusData {
+    char m_magic[8];
+    uint32_t m_size;                //sizeof(StatusPageLayout), a layout check for readers
+    int32_t m_shellPID;
+    int64_t m_shellStart;           //CLOCK_REALTIME ns
+    int64_t m_updated;
+    int64_t m_cpuSampled;           //when the jobs' CPU times were read, at most a second before m_updated
+    uint64_t m_commands;            //lines executed
+    uint64_t m_jobsStarted;         //background jobs
+    uint64_t m_jobsFinished;        //background jobs and parallel tasks reaped
+    int32_t m_fgPID;                //-1 at the prompt
+    uint32_t m_jobCount;            //jobs in the list, m_jobs holds the first STATUS_MAX_JOBS
+    char m_fgCommand[STATUS_COMMAND_MAX + 1];
+    StatusJob m_jobs[STATUS_MAX_JOBS];
+};
+
+//the shared file: a seqlock sequence, odd while smash is writing, then the data
+struct StatusPageLayout {
+    std::atomic<uint64_t> m_sequence;
+    char m_padding[56];             //the data starts on its own cache line
+    StatusData m_data;
+};
+
+//smash's job table and counters in /dev/shm/smash-<pid> (the directory is $SMASH_STATUS_DIR
+//if set), for monitoring without running jobs in a pipe. smash writes under a seqlock; a
+//reader maps the file and copies it lock-free, retrying while a write overlaps the copy.
+class StatusPage {
+    std::string m_path;
+    pid_t m_owner = -1;             //forked children must not unlink it
+    StatusPageLayout *m_page = nullptr;
+
+public:
+    StatusPage() = default;
+
+    StatusPage(StatusPage const &) = delete;
+
+    void operator=(StatusPage const &) = delete;
+
+    ~StatusPage();
+
+    static std::string pathFor(pid_t pid);
+
+    //creates (or truncates) the file at path. false if it could not be created
+    bool create(const std::string &path);
+
+    bool isOpen() const;
+
+    //the data to fill in between beginWrite() and endWrite()
+    StatusData &data();
+
+    void beginWrite();
+
+    void endWrite();
+
+    //unmaps and unlinks the file
+    void remove();
+
+    //reader side: maps path read-only. nullptr if it is missing or not a status page
+    static const StatusPageLayout *map(const std::string &path);
+
+    static void unmap(const StatusPageLayout *page);
+
+    //a consistent copy of page. false if every attempt overlapped a write
+    static bool snapshot(const StatusPageLayout *page, StatusData &copy);
+};
+
+#endif //SMASH_STATUS_PAGE_H_
@@ -0,0 +1,142 @@
+#include "TextScan.h"
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TEXT_SCAN_X86
+#endif
+
+//per-byte match counters are 8 bits wide, so they are summed up at least every 255 blocks
+#define COUNT_ROUNDS (255)
+
+struct TextKernels {
+    size_t (*m_countByte)(const char *, size_t, char);
+    const char *(*m_findLiteral)(const char *, size_t, const char *, size_t);
+    const char *m_name;
+};
+
+static size_t countByteScalar(const char *data, size_t length, char c) {
+    size_t count = 0;
+    for (size_t i = 0; i < length; i++) count += data[i] == c;
+    return count;
+}
+
+static const char *findLiteralScalar(const char *haystack, size_t length, const char *needle, size_t needleLength) {
+    return static_cast<const char *>(memmem(haystack, length, needle, needleLength));
+}
+
+#ifdef TEXT_SCAN_X86
+
+__attribute__((target("sse2")))
+static size_t countByteSse2(const char *data, size_t length, char c) {
+    const __m128i target = _mm_set1_epi8(c);
+    size_t count = 0, i = 0;
+    while (length - i >= 16) {
+        __m128i counters = _mm_setzero_si128();
+        for (int round = 0; round < COUNT_ROUNDS && length - i >= 16; round++, i += 16) {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+            counters = _mm_sub_epi8(counters, _mm_cmpeq_epi8(block, target));    //a match is -1
+        }
+        __m128i sums = _mm_sad_epu8(counters, _mm_setzero_si128());
+        count += (size_t) _mm_cvtsi128_si32(sums) + (size_t) _mm_cvtsi128_si32(_mm_srli_si128(sums, 8));
+    }
+    return count + countByteScalar(data + i, length - i, c);
+}
+
+//compares a block of positions against the needle's first and last byte at once; only where
+//both agree (rare in real text) the middle is memcmp'd. the tail goes to memmem
+__attribute__((target("sse2")))
+static const char *findLiteralSse2(const char *haystack, size_t length, const char *needle, size_t needleLength) {
+    if (needleLength < 2 || needleLength > length) {
+        return findLiteralScalar(haystack, length, needle, needleLength);
+    }
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[needleLength - 1]);
+    size_t i = 0;
+    for (; i + needleLength - 1 + 16 <= length; i += 16) {
+        __m128i blockFirst = _mm_loadu_si128(reinterpret_cast<const __m128i *>(haystack + i));
+        __m128i blockLast = _mm_loadu_si128(reinterpret_cast<const __m128i *>(haystack + i + needleLength - 1));
+        unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(blockFirst, first),
+                                                        _mm_cmpeq_epi8(blockLast, last)));
+        while (mask != 0) {
+            int offset = __builtin_ctz(mask);
+            if (memcmp(haystack + i + offset + 1, needle + 1, needleLength - 2) == 0) return haystack + i + offset;
+            mask &= mask - 1;
+        }
+    }
+    return findLiteralScalar(haystack + i, length - i, needle, needleLength);
+}
+
+__attribute__((target("avx2")))
+static size_t countByteAvx2(const char *data, size_t length, char c) {
+    const __m256i target = _mm256_set1_epi8(c);
+    size_t count = 0, i = 0;
+    while (length - i >= 32) {
+        __m256i counters = _mm256_setzero_si256();
+        for (int round = 0; round < COUNT_ROUNDS && length - i >= 32; round++, i += 32) {
+            __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+            counters = _mm256_sub_epi8(counters, _mm256_cmpeq_epi8(block, target));
+        }
+        uint64_t sums[4];
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(sums), _mm256_sad_epu8(counters, _mm256_setzero_si256()));
+        count += sums[0] + sums[1] + sums[2] + sums[3];
+    }
+    return count + countByteSse2(data + i, length - i, c);
+}
+
+__attribute__((target("avx2")))
+static const char *findLiteralAvx2(const char *haystack, size_t length, const char *needle, size_t needleLength) {
+    if (needleLength < 2 || needleLength > length) {
+        return findLiteralScalar(haystack, length, needle, needleLength);
+    }
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[needleLength - 1]);
+    size_t i = 0;
+    for (; i + needleLength - 1 + 32 <= length; i += 32) {
+        __m256i blockFirst = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(haystack + i));
+        __m256i blockLast = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(haystack + i + needleLength - 1));
+        unsigned mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(blockFirst, first),
+                                                              _mm256_cmpeq_epi8(blockLast, last)));
+        while (mask != 0) {
+            int offset = __builtin_ctz(mask);
+            if (memcmp(haystack + i + offset + 1, needle + 1, needleLength - 2) == 0) return haystack + i + offset;
+            mask &= mask - 1;
+        }
+    }
+    return findLiteralSse2(haystack + i, length - i, needle, needleLength);
+}
+
+#endif //TEXT_SCAN_X86
+
+static TextKernels pickKernels() {
+    const char *forced = getenv("SMASH_TEXT_ISA");
+    std::string wanted = forced != nullptr ? forced : "";
+#ifdef TEXT_SCAN_X86
+    __builtin_cpu_init();
+    if (wanted != "sse2" && wanted != "scalar" && __builtin_cpu_supports("avx2")) {
+        return {countByteAvx2, findLiteralAvx2, "avx2"};
+    }
+    if (wanted != "scalar" && __builtin_cpu_supports("sse2")) return {countByteSse2, findLiteralSse2, "sse2"};
+#endif
+    return {countByteScalar, findLiteralScalar, "scalar"};
+}
+
+static const TextKernels &kernels() {
+    static const TextKernels chosen = pickKernels();
+    return chosen;
+}
+
+size_t countByte(const char *data, size_t length, char c) {
+    return kernels().m_countByte(data, length, c);
+}
+
+const char *findLiteral(const char *haystack, size_t length, const char *needle, size_t needleLength) {
+    return kernels().m_findLiteral(haystack, length, needle, needleLength);
+}
+
+const char *textScanIsa() {
+    return kernels().m_name;
+}
@@ -0,0 +1,20 @@
+#ifndef SMASH_TEXT_SCAN_H_
+#define SMASH_TEXT_SCAN_H_
+
+#include <cstddef>
+
+//byte scanning kernels behind the wc, head and grep built-ins. the first call picks the AVX2,
+//SSE2 or plain C version by what the CPU supports; $SMASH_TEXT_ISA (avx2, sse2 or scalar)
+//can force a lower one for testing and benchmarks.
+
+//how many bytes in [data, data + length) equal c
+size_t countByte(const char *data, size_t length, char c);
+
+//the first occurrence of needle in [haystack, haystack + length), nullptr if there is none.
+//an empty needle is found at haystack
+const char *findLiteral(const char *haystack, size_t length, const char *needle, size_t needleLength);
+
+//the kernels in use: "avx2", "sse2" or "scalar"
+const char *textScanIsa();
+
+#endif //SMASH_TEXT_SCAN_H_
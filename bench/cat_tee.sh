@@ -0,0 +1,33 @@
+#!/bin/bash
+# cat/tee throughput: smash built-ins vs coreutils, both launched through smash.
+# usage: bench/cat_tee.sh [size-MB] [smash-binary]
+# prints one line per scenario: <scenario> <builtin GB/s> <coreutils GB/s>
+
+SIZE_MB=${1:-512}
+SMASH=${2:-./smash}
+DIR=$(mktemp -d /tmp/smash_bench.XXXXXX)
+trap 'rm -rf "$DIR"' EXIT
+
+head -c "$((SIZE_MB * 1024 * 1024))" /dev/urandom > "$DIR/in.bin"
+CAT=$(command -v cat)
+TEE=$(command -v tee)
+
+# runs one command line through smash, prints GB/s
+run() {
+    local start end
+    start=$(date +%s%N)
+    printf '%s\nquit\n' "$1" | "$SMASH" > /dev/null
+    end=$(date +%s%N)
+    awk -v bytes="$((SIZE_MB * 1024 * 1024))" -v ns="$((end - start))" \
+        'BEGIN { printf "%.2f", bytes / ns }'
+}
+
+scenario() {
+    printf '%-14s %8s %10s\n' "$1" "$(run "$2")" "$(run "$3")"
+}
+
+printf '%-14s %8s %10s\n' "scenario" "builtin" "coreutils"
+scenario "file>file" "cat $DIR/in.bin > $DIR/out.bin" "$CAT $DIR/in.bin > $DIR/out.bin"
+scenario "file|pipe" "cat $DIR/in.bin | wc -c" "$CAT $DIR/in.bin | wc -c"
+scenario "pipe|tee|pipe" "cat $DIR/in.bin | tee $DIR/out.bin | wc -c" \
+    "$CAT $DIR/in.bin | $TEE $DIR/out.bin | wc -c"
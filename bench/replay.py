@@ -0,0 +1,166 @@
+#!/usr/bin/env python3
+# end-to-end load: a script of built-ins, externals, pipelines, redirections, globs and & jobs
+# piped through smash, once per launch mode. reports commands/sec, peak RSS and the latency
+# percentiles smash's own `stats` recorded for each phase and kind of line.
+# usage: bench/replay.py [--smash ./smash] [--commands 5000] [--seed 1] [--runs 3]
+#                        [--modes fork:bash,spawn:bash,fork:internal,spawn:internal]
+#                        [--script file | --save file] [--per-class] [--json]
+# a mode is launch:glob, passed to smash as $SMASH_LAUNCH and $SMASH_GLOB.
+# --script replays a saved (or hand-written) script; {dir} in it is the scratch directory.
+
+import argparse
+import json
+import os
+import random
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+# class -> (weight in the mix, line templates)
+CLASSES = {
+    "builtin":     (30, ["pwd", "showpid", "cd {dir}", "jobs", "alias ll='ls -l'", "unalias ll"]),
+    "true":        (15, ["true"]),
+    "echo":        (15, ["/bin/echo hello {n}"]),
+    "pipe":        (10, ["/bin/echo a b {n} | wc -w", "pwd | cat"]),
+    "redirection": (10, ["/bin/echo {n} > {dir}/out.txt", "pwd >> {dir}/out.txt"]),
+    "glob":        (10, ["ls {dir}/*.txt", "/bin/echo {dir}/file?.txt"]),
+    "background":  (10, ["true &", "/bin/echo {n} > /dev/null &"]),
+}
+
+UNITS = {"ns": 1e-3, "us": 1.0, "ms": 1e3, "s": 1e6}
+
+
+def generate(count, seed, classes):
+    rng = random.Random(seed)
+    names = list(classes)
+    weights = [CLASSES[name][0] for name in names]
+    lines = []
+    for n in range(count):
+        name = rng.choices(names, weights)[0]
+        lines.append(rng.choice(CLASSES[name][1]).replace("{n}", str(n)))
+    return lines
+
+
+def microseconds(text):
+    for suffix in ("ns", "us", "ms", "s"):
+        if text.endswith(suffix):
+            return float(text[:-len(suffix)]) * UNITS[suffix]
+    raise ValueError("bad duration " + text)
+
+
+# the table `stats` prints: phase kind count p50 p99 max
+def parse_stats(path):
+    latency = {}
+    with open(path) as table:
+        for line in table:
+            fields = line.split()
+            if len(fields) != 6 or fields[0] == "phase":
+                continue
+            latency[fields[0] + "/" + fields[1]] = {
+                "count": int(fields[2]),
+                "p50_us": microseconds(fields[3]),
+                "p99_us": microseconds(fields[4]),
+                "max_us": microseconds(fields[5]),
+            }
+    return latency
+
+
+# one smash over the script. returns (seconds, peak RSS in KB, latency table)
+def run(smash, body, scratch, launch, glob):
+    stats_file = os.path.join(scratch, "stats.txt")
+    script = ["stats on"] + [line.replace("{dir}", scratch) for line in body]
+    script += ["stats > " + stats_file, "quit kill"]
+    env = dict(os.environ, SMASH_LAUNCH=launch, SMASH_GLOB=glob, SMASH_STATUS_DIR=scratch,
+               SMASH_HISTFILE=os.path.join(scratch, "history"), SMASH_DIRFILE=os.path.join(scratch, "dirs"))
+    with tempfile.TemporaryFile() as stdin:
+        stdin.write(("\n".join(script) + "\n").encode())
+        stdin.seek(0)
+        start = time.monotonic()
+        child = subprocess.Popen([smash], stdin=stdin, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL,
+                                 env=env, cwd=scratch)
+        _, status, usage = os.wait4(child.pid, 0)
+        seconds = time.monotonic() - start
+    child.returncode = os.waitstatus_to_exitcode(status)
+    if child.returncode != 0:
+        sys.exit("replay: smash exited with %d in mode %s:%s" % (child.returncode, launch, glob))
+    return seconds, usage.ru_maxrss, parse_stats(stats_file)
+
+
+# runs per mode, keeps the median run by wall time
+def measure(smash, body, scratch, modes, runs):
+    results = []
+    for mode in modes:
+        launch, glob = mode.split(":")
+        samples = sorted((run(smash, body, scratch, launch, glob) for _ in range(runs)), key=lambda s: s[0])
+        seconds, rss, latency = samples[len(samples) // 2]
+        results.append({"mode": mode, "commands": len(body), "seconds": seconds,
+                        "commands_per_sec": len(body) / seconds,
+                        "peak_rss_kb": max(sample[1] for sample in samples), "latency": latency})
+    return results
+
+
+def print_results(title, results):
+    print(title)
+    print("%-16s %8s %10s %10s" % ("mode", "commands", "cmd/s", "peak RSS"))
+    for result in results:
+        print("%-16s %8d %10.1f %8.1fMB" % (result["mode"], result["commands"], result["commands_per_sec"],
+                                           result["peak_rss_kb"] / 1024))
+    rows = sorted({key for result in results for key in result["latency"]},
+                  key=lambda key: (["parse", "fork", "exec", "wait", "reap", "total"].index(key.split("/")[0]), key))
+    if not rows:
+        return
+    print("\n%-20s" % "p50/p99 us" + "".join("%20s" % result["mode"] for result in results))
+    for row in rows:
+        cells = ""
+        for result in results:
+            entry = result["latency"].get(row)
+            cells += "%20s" % ("%.1f/%.1f" % (entry["p50_us"], entry["p99_us"]) if entry else "-")
+        print("%-20s%s" % (row, cells))
+    print()
+
+
+def main():
+    parser = argparse.ArgumentParser(description="smash end-to-end replay load")
+    parser.add_argument("--smash", default="./smash")
+    parser.add_argument("--commands", type=int, default=5000)
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--runs", type=int, default=3)
+    parser.add_argument("--modes", default="fork:bash,spawn:bash,fork:internal,spawn:internal")
+    parser.add_argument("--script", help="replay this script instead of generating one")
+    parser.add_argument("--save", help="write the generated script here")
+    parser.add_argument("--per-class", action="store_true", help="also run each class alone")
+    parser.add_argument("--json", action="store_true", help="one JSON object per mode and mix")
+    args = parser.parse_args()
+
+    smash = os.path.abspath(args.smash)
+    modes = args.modes.split(",")
+    if args.script:
+        with open(args.script) as script:
+            mixes = [("replay", [line.rstrip("\n") for line in script if line.strip()])]
+    else:
+        mixes = [("mix", generate(args.commands, args.seed, CLASSES))]
+        if args.save:
+            with open(args.save, "w") as save:
+                save.write("\n".join(mixes[0][1]) + "\n")
+        if args.per_class:
+            mixes += [(name, generate(args.commands, args.seed, {name: CLASSES[name]})) for name in CLASSES]
+
+    scratch = tempfile.mkdtemp(prefix="smash_replay.")
+    try:
+        for i in range(3):
+            open(os.path.join(scratch, "file%d.txt" % i), "w").close()
+        for name, body in mixes:
+            results = measure(smash, body, scratch, modes, args.runs)
+            if args.json:
+                for result in results:
+                    print(json.dumps(dict(result, mix=name)))
+            else:
+                print_results(name, results)
+    finally:
+        shutil.rmtree(scratch)
+
+
+if __name__ == "__main__":
+    main()
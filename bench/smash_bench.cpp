@@ -0,0 +1,228 @@
+//micro-benchmarks of smash's parser, dispatch and job table.
+//usage: smash_bench [--filter substring] [--min-time seconds]
+//prints one JSON object per benchmark, e.g.
+//  {"name":"CreateCommand/builtin","ns_per_op":812.4,"min_ns_per_op":790.1,"iterations":262144,"build":"Release"}
+//ns_per_op is the median of the samples; compare runs of the same build type only.
+#include "../Commands.h"
+#include "../TextScan.h"
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <time.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef SMASH_BENCH_BUILD
+#define SMASH_BENCH_BUILD "unknown"
+#endif
+
+#define SAMPLES (7)
+
+static const char *s_filter = "";
+static double s_minTime = 0.5;      //seconds per benchmark
+
+//keeps the compiler from dropping a computation whose result is unused
+template<class T>
+static void keep(T const &value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+static uint64_t nowNs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+template<class F>
+static uint64_t timeBatch(F &f, uint64_t iterations) {
+    uint64_t start = nowNs();
+    for (uint64_t i = 0; i < iterations; i++) f();
+    return nowNs() - start;
+}
+
+//batch sizes double until a batch takes 1/SAMPLES of the time budget, then SAMPLES batches
+//are timed. prints the median and the fastest ns per call
+template<class F>
+static void bench(const std::string &name, F f) {
+    if (name.find(s_filter) == std::string::npos) return;
+    uint64_t target = (uint64_t) (s_minTime * 1e9 / SAMPLES);
+    uint64_t iterations = 1;
+    while (timeBatch(f, iterations) < target && iterations < (1ull << 32)) iterations *= 2;
+    std::vector<double> perOp;
+    for (int sample = 0; sample < SAMPLES; sample++) {
+        perOp.push_back((double) timeBatch(f, iterations) / iterations);
+    }
+    std::sort(perOp.begin(), perOp.end());
+    printf("{\"name\":\"%s\",\"ns_per_op\":%.1f,\"min_ns_per_op\":%.1f,\"iterations\":%llu,\"build\":\"%s\"}\n",
+           name.c_str(), perOp[SAMPLES / 2], perOp[0], (unsigned long long) iterations, SMASH_BENCH_BUILD);
+    fflush(stdout);
+}
+
+static void benchParsing() {
+    const std::string line = "  ls -la /usr/share/doc --color=never | grep -v README > /tmp/listing.txt &  ";
+    bench("parseCommandLine", [&]() {
+        std::vector<std::string> args;
+        keep(parseCommandLine(line, &args));
+    });
+    bench("_trim", [&]() { keep(_trim(line)); });
+    bench("removeBackgroundSign", [&]() { keep(removeBackgroundSign(line)); });
+
+    std::ifstream statFile("/proc/self/stat");
+    std::string statLine((std::istreambuf_iterator<char>(statFile)), std::istreambuf_iterator<char>());
+    bench("parseUtimeStime", [&]() {
+        unsigned long long utime, stime;
+        keep(parseUtimeStime(statLine, utime, stime));
+    });
+}
+
+//CreateCommand + delete for every kind of line, through the parse cache (the shell thread)
+//and without it (any other thread parses from scratch)
+static void benchDispatch() {
+    SmallShell &smash = SmallShell::getInstance();
+    const char *lines[][2] = {{"builtin",     "pwd"},
+                              {"external",    "ls -l /tmp"},
+                              {"pipe",        "ls -l /tmp | wc -l"},
+                              {"redirection", "ls -l /tmp > /dev/null"},
+                              {"background",  "sleep 100 &"}};
+    for (const auto &line: lines) {
+        auto create = [&]() {
+            LineArena &arena = LineArena::current();
+            LineArena::Mark mark = arena.mark();
+            Command *cmd = smash.CreateCommand(line[1]);
+            keep(cmd);
+            delete cmd;
+            arena.rewind(mark);
+        };
+        bench(std::string("CreateCommand/") + line[0], create);
+        std::thread uncached([&]() { bench(std::string("CreateCommand/") + line[0] + "/uncached", create); });
+        uncached.join();
+    }
+}
+
+static void benchAliases() {
+    SmallShell &smash = SmallShell::getInstance();
+    smash.m_aliasMap["ll"] = "ls -l";
+    smash.m_aliasMap["lla"] = "ll -a";
+    smash.m_aliasMap["llah"] = "lla -h";
+    for (int i = 0; i < 100; i++) smash.m_aliasMap["other" + std::to_string(i)] = "echo " + std::to_string(i);
+    smash.aliasesChanged();
+    auto expand = [&](const char *line) {
+        LineArena &arena = LineArena::current();
+        LineArena::Mark mark = arena.mark();
+        keep(smash.expandAlias(line));
+        arena.rewind(mark);
+    };
+    bench("expandAlias/none", [&]() { expand("ls -l /tmp"); });
+    bench("expandAlias/chain3", [&]() { expand("llah /tmp"); });
+    bench("aliasesChanged/103", [&]() { keep(smash.aliasesChanged()); });
+    smash.m_aliasMap.clear();
+    smash.aliasesChanged();
+}
+
+//the job table with jobCount live children, so removeFinishedJobs really waits on each
+static void benchJobs(int jobCount) {
+    JobsList jobs;
+    std::vector<pid_t> children;
+    LineArena &arena = LineArena::current();
+    LineArena::Mark mark = arena.mark();
+    Command *cmd = new ExternalCommand("sleep 100&");
+    for (int i = 0; i < jobCount; i++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            pause();
+            _exit(0);
+        }
+        children.push_back(pid);
+        jobs.addJob(cmd, false, pid);
+    }
+    int devNull = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    std::string suffix = "/" + std::to_string(jobCount);
+    int lastId = jobCount;
+    bench("JobsList/removeFinishedJobs" + suffix, [&]() { jobs.removeFinishedJobs(); });
+    bench("JobsList/getJobById" + suffix, [&]() { keep(jobs.getJobById(lastId)); });
+    bench("JobsList/addRemove" + suffix, [&]() {
+        jobs.addJob(cmd, false, children[0]);
+        jobs.removeJobById(jobCount + 1);
+    });
+    bench("JobsList/printJobsList" + suffix, [&]() {
+        ScopedIo io(STDIN_FILENO, devNull, devNull);
+        jobs.printJobsList();
+    });
+    close(devNull);
+    for (pid_t pid: children) {
+        kill(pid, SIGKILL);
+        waitpid(pid, nullptr, 0);
+    }
+    delete cmd;
+    arena.rewind(mark);
+}
+
+//du over a generated tree of 10 x 10 directories with 10 files each
+static void benchDu() {
+    char root[] = "/tmp/smash_bench.XXXXXX";
+    if (mkdtemp(root) == nullptr) {
+        perror("smash_bench: mkdtemp");
+        return;
+    }
+    std::string data(3000, 'x');
+    for (int a = 0; a < 10; a++) {
+        std::string first = std::string(root) + "/d" + std::to_string(a);
+        mkdir(first.c_str(), 0755);
+        for (int b = 0; b < 10; b++) {
+            std::string second = first + "/d" + std::to_string(b);
+            mkdir(second.c_str(), 0755);
+            for (int c = 0; c < 10; c++) {
+                std::ofstream(second + "/f" + std::to_string(c)) << data;
+            }
+        }
+    }
+    bench("recursiveFolderSizeCalc/1000files", [&]() { keep(recursiveFolderSizeCalc(root, true)); });
+    std::string remove = std::string("rm -rf ") + root;
+    if (system(remove.c_str()) != 0) fprintf(stderr, "smash_bench: could not remove %s\n", root);
+}
+
+//the wc/grep kernels over 1MB of 40 byte lines, one "needle" in 50 of them
+static void benchTextScan() {
+    std::string text;
+    for (int line = 0; text.size() < (1 << 20); line++) {
+        text += line % 50 == 49 ? "alpha beta gamma delta needle epsilon\n" : "alpha beta gamma delta epsilon zeta\n";
+    }
+    std::string suffix = std::string("/1MB/") + textScanIsa();
+    bench("countByte" + suffix, [&]() { keep(countByte(text.data(), text.size(), '\n')); });
+    bench("findLiteral/absent" + suffix, [&]() { keep(findLiteral(text.data(), text.size(), "needles", 7)); });
+}
+
+int main(int argc, char *argv[]) {
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--filter") == 0) {
+            s_filter = argv[i + 1];
+        } else if (strcmp(argv[i], "--min-time") == 0) {
+            s_minTime = atof(argv[i + 1]);
+        } else {
+            fprintf(stderr, "usage: smash_bench [--filter substring] [--min-time seconds]\n");
+            return 2;
+        }
+    }
+    if (argc % 2 == 0) {
+        fprintf(stderr, "usage: smash_bench [--filter substring] [--min-time seconds]\n");
+        return 2;
+    }
+    benchParsing();
+    benchDispatch();
+    benchAliases();
+    benchJobs(1);
+    benchJobs(100);
+    benchDu();
+    benchTextScan();
+    return 0;
+}
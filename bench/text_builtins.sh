@@ -0,0 +1,75 @@
+#!/bin/bash
+# wc/head/grep -F built-ins vs the coreutils and grep binaries, all launched through smash.
+# usage: bench/text_builtins.sh [size-MB] [smash-binary] [repeats]
+# the first table reads a generated text file of size-MB and prints MB/s, the second runs each
+# command `repeats` times on a 20 line file and prints commands/sec. columns: the built-in with
+# the best kernels of this CPU, the built-in forced to the scalar ones, the binary.
+
+SIZE_MB=${1:-256}
+SMASH=${2:-./smash}
+REPEATS=${3:-2000}
+DIR=$(mktemp -d /tmp/smash_bench.XXXXXX)
+trap 'rm -rf "$DIR"' EXIT
+
+WC=$(command -v wc)
+HEAD=$(command -v head)
+GREP=$(command -v grep)
+
+# a 1MB block of words, one needle in ~50 lines, repeated
+awk 'BEGIN {
+    srand(1)
+    split("alpha beta gamma delta epsilon zeta eta theta iota kappa lambda", words, " ")
+    for (size = 0; size < 1048576;) {
+        line = ""
+        for (i = int(rand() * 12); i >= 0; i--) line = line words[int(rand() * 11) + 1] " "
+        if (rand() < 0.02) line = line "needle"
+        print line
+        size += length(line) + 1
+    }
+}' > "$DIR/block.txt"
+for ((i = 0; i < SIZE_MB; i++)); do cat "$DIR/block.txt"; done > "$DIR/text.txt"
+head -n 20 "$DIR/block.txt" > "$DIR/small.txt"
+TEXT=$DIR/text.txt
+SMALL=$DIR/small.txt
+
+# runs stdin through smash with the given environment, prints the elapsed ns. the output goes
+# to a file: grep treats a stdout on /dev/null like -q
+elapsed() {
+    local start end
+    start=$(date +%s%N)
+    env "$@" "$SMASH" > "$DIR/out.txt"
+    end=$(date +%s%N)
+    echo $((end - start))
+}
+
+throughput() {
+    local ns
+    ns=$(printf '%s\nquit\n' "$1" | elapsed "${@:2}")
+    awk -v bytes="$((SIZE_MB * 1024 * 1024))" -v ns="$ns" 'BEGIN { printf "%.0f", bytes / ns * 1000 }'
+}
+
+rate() {
+    local ns
+    ns=$( (yes "$1" | "$HEAD" -n "$REPEATS"; echo quit) | elapsed "${@:2}")
+    awk -v count="$REPEATS" -v ns="$ns" 'BEGIN { printf "%.0f", count / ns * 1e9 }'
+}
+
+# scenario <measure> <name> <built-in line> <binary line>
+scenario() {
+    printf '%-16s %10s %10s %10s\n' "$2" "$($1 "$3" SMASH_TEXT_BUILTINS=on)" \
+        "$($1 "$3" SMASH_TEXT_BUILTINS=on SMASH_TEXT_ISA=scalar)" "$($1 "$4" SMASH_TEXT_BUILTINS=off)"
+}
+
+printf '%-16s %10s %10s %10s\n' "MB/s" "builtin" "scalar" "binary"
+scenario throughput "wc -l" "wc -l $TEXT" "$WC -l $TEXT"
+scenario throughput "cat | wc -l" "cat $TEXT | wc -l" "cat $TEXT | $WC -l"
+scenario throughput "grep -Fc" "grep -Fc needle $TEXT" "$GREP -Fc needle $TEXT"
+scenario throughput "grep -F | wc -l" "grep -F needle $TEXT | wc -l" "$GREP -F needle $TEXT | $WC -l"
+scenario throughput "grep -Fvc" "grep -Fvc needle $TEXT" "$GREP -Fvc needle $TEXT"
+scenario throughput "head -n | wc -c" "head -n 100000000 $TEXT | wc -c" "$HEAD -n 100000000 $TEXT | $WC -c"
+
+printf '\n%-16s %10s %10s %10s\n' "commands/s" "builtin" "scalar" "binary"
+scenario rate "head -n 5" "head -n 5 $SMALL" "$HEAD -n 5 $SMALL"
+scenario rate "wc -l" "wc -l $SMALL" "$WC -l $SMALL"
+scenario rate "grep -F" "grep -F needle $SMALL" "$GREP -F needle $SMALL"
+scenario rate "cat|grep -F|wc" "cat $SMALL | grep -F needle | wc -l" "cat $SMALL | $GREP -F needle | $WC -l"
@@ -1,19 +1,67 @@
 #include <iostream>
 #include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
 #include "signals.h"
 #include "Commands.h"
 
 using namespace std;
 
+static volatile sig_atomic_t s_ctrlC = 0;
+
+bool takeCtrlC() {
+    bool pending = s_ctrlC;
+    s_ctrlC = 0;
+    return pending;
+}
+
+bool ctrlCPending() {
+    return s_ctrlC;
+}
+
 void ctrlCHandler(int sig_num) {
+    s_ctrlC = 1;
     std::cout << "smash: got ctrl-C" << endl;
     SmallShell &smash = SmallShell::getInstance();
-    if (smash.getFgProcPID() > 0) {
-        if (kill(smash.getFgProcPID(), SIGINT) == -1) {
+    pid_t fgPid = smash.getFgProcPID();     //read once: a pipeline stage thread may clear it meanwhile
+    if (fgPid > 0) {
+        if (kill(fgPid, SIGINT) == -1) {
             perror("smash error: kill failed");
         } else {
-            std::cout << "smash: process " << smash.getFgProcPID() << " was killed" << std::endl;
-            smash.clearFgJob();
+            std::cout << "smash: process " << fgPid << " was killed" << std::endl;
+            smash.dropFgProcPID();
         }
     }
 }
+
+static int s_childPipe[2] = {-1, -1};
+
+static void sigchldHandler(int sig_num) {
+    int savedErrno = errno;
+    char byte = 0;
+    if (write(s_childPipe[1], &byte, 1) == -1) {}     //full pipe: a wakeup is pending anyway
+    errno = savedErrno;
+}
+
+void installChildHandler() {
+    if (s_childPipe[0] != -1) return;
+    if (pipe2(s_childPipe, O_NONBLOCK | O_CLOEXEC) == -1) {
+        perror("smash error: pipe failed");
+        return;
+    }
+    struct sigaction action = {};
+    action.sa_handler = sigchldHandler;
+    action.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGCHLD, &action, nullptr) == -1) perror("smash error: sigaction failed");
+}
+
+int childEventFd() {
+    return s_childPipe[0];
+}
+
+void drainChildEvents() {
+    char buffer[64];
+    while (s_childPipe[0] != -1 && read(s_childPipe[0], buffer, sizeof(buffer)) > 0) {}
+}
@@ -3,4 +3,20 @@
 
 void ctrlCHandler(int sig_num);
 
+//true once per ctrl-C since the last call. for built-ins that wait on several children
+bool takeCtrlC();
+
+//whether a ctrl-C is pending, without taking it. for pipeline stage threads, which leave it
+//to smash's thread
+bool ctrlCPending();
+
+//from the first "jobq on": SIGCHLD writes a byte to a self-pipe, so the prompt and
+//foreground waits wake up to start queued jobs. idempotent
+void installChildHandler();
+
+//read end of that pipe, -1 before installChildHandler()
+int childEventFd();
+
+void drainChildEvents();
+
 #endif //SMASH__SIGNALS_H_
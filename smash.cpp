@@ -4,6 +4,7 @@
 #include <signal.h>
 #include "Commands.h"
 #include "signals.h"
+#include "LineEditor.h"
 
 int main(int argc, char *argv[]) {
     if (signal(SIGINT, ctrlCHandler) == SIG_ERR) {
@@ -12,10 +13,12 @@ int main(int argc, char *argv[]) {
 
 
     SmallShell &smash = SmallShell::getInstance();
+    LineEditor editor;
+    std::string cmd_line;
     while (true) {
-        std::cout << smash.getPrompt() << "> ";
-        std::string cmd_line;
-        std::getline(std::cin, cmd_line);
+        if (takeCtrlC()) smash.publishStatus();     //the handler only dropped the foreground pid
+        smashOut() << smash.getPrompt() << "> " << std::flush;  //with the last command's output
+        if (!editor.readLine(smash.getPrompt() + "> ", cmd_line)) break;    //end of input
         smash.executeCommand(cmd_line.c_str());
     }
     return 0;
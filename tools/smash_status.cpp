@@ -0,0 +1,78 @@
+//smash_status [pid]: prints the status page of one smash, or of every running one.
+//reads the shared page only - smash itself is never asked anything.
+#include "../StatusPage.h"
+#include <dirent.h>
+#include <signal.h>
+#include <time.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static const char *const STATE_NAMES[] = {"running", "stopped", "queued", "waiting"};
+
+static bool printPage(pid_t pid) {
+    const StatusPageLayout *page = StatusPage::map(StatusPage::pathFor(pid));
+    if (page == nullptr) {
+        fprintf(stderr, "smash_status: no status page for pid %d\n", pid);
+        return false;
+    }
+    StatusData data;
+    bool consistent = StatusPage::snapshot(page, data);
+    StatusPage::unmap(page);
+    if (!consistent) {
+        fprintf(stderr, "smash_status: pid %d: page kept changing\n", pid);
+        return false;
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    int64_t nowNs = now.tv_sec * 1000000000ll + now.tv_nsec;
+    printf("smash %d: up %.1fs, updated %.3fs ago (CPU times %.3fs ago), %llu commands, %llu jobs started, "
+           "%llu finished\n", data.m_shellPID, (nowNs - data.m_shellStart) / 1e9, (nowNs - data.m_updated) / 1e9,
+           (nowNs - data.m_cpuSampled) / 1e9,
+           (unsigned long long) data.m_commands, (unsigned long long) data.m_jobsStarted,
+           (unsigned long long) data.m_jobsFinished);
+    if (data.m_fgPID != -1) printf("  foreground %d: %s\n", data.m_fgPID, data.m_fgCommand);
+    uint32_t shown = data.m_jobCount < STATUS_MAX_JOBS ? data.m_jobCount : STATUS_MAX_JOBS;
+    for (uint32_t i = 0; i < shown; i++) {
+        const StatusJob &job = data.m_jobs[i];
+        printf("  [%d] %-7d %-8s %8.1fs  user %.2fs sys %.2fs  %s\n", job.m_jobID, job.m_pid,
+               job.m_state < 4 ? STATE_NAMES[job.m_state] : "?", (nowNs - job.m_startTime) / 1e9,
+               job.m_userTime / 1e6, job.m_systemTime / 1e6, job.m_command);
+    }
+    if (data.m_jobCount > shown) printf("  ... %u more jobs\n", data.m_jobCount - shown);
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 2) {
+        fprintf(stderr, "usage: smash_status [pid]\n");
+        return 2;
+    }
+    if (argc == 2) return printPage(atoi(argv[1])) ? 0 : 1;
+
+    std::string path = StatusPage::pathFor(0);
+    std::string dir = path.substr(0, path.rfind('/'));
+    DIR *stream = opendir(dir.c_str());
+    if (stream == nullptr) {
+        perror(dir.c_str());
+        return 1;
+    }
+    std::vector<pid_t> pids;
+    while (struct dirent *entry = readdir(stream)) {
+        const char *name = entry->d_name;
+        if (strncmp(name, "smash-", 6) != 0 || name[6] == '\0' || strspn(name + 6, "0123456789") != strlen(name + 6)) {
+            continue;
+        }
+        pid_t pid = atoi(name + 6);
+        //a smash that was killed leaves its page behind
+        if (kill(pid, 0) == -1 && errno == ESRCH) continue;
+        pids.push_back(pid);
+    }
+    closedir(stream);
+    bool ok = true;
+    for (pid_t pid: pids) ok = printPage(pid) && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,122 @@
+//status page seqlock test: a writer process rewrites the page as fast as it can while a
+//reader process snapshots it. every write makes all fields agree on one generation, so a
+//snapshot mixing two writes is caught. exits 1 on a torn or failed snapshot.
+#include "../StatusPage.h"
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#define WRITES (200000)
+
+static void fill(StatusData &data, uint64_t generation) {
+    data.m_commands = generation;
+    data.m_jobsStarted = generation * 3;
+    data.m_jobsFinished = generation * 7;
+    data.m_jobCount = generation % (STATUS_MAX_JOBS + 1);
+    for (uint32_t i = 0; i < data.m_jobCount; i++) {
+        StatusJob &job = data.m_jobs[i];
+        job.m_jobID = i + 1;
+        job.m_pid = (int32_t) generation;
+        job.m_startTime = generation * 1000 + i;
+        snprintf(job.m_command, sizeof(job.m_command), "job %llu/%u %0120llu", (unsigned long long) generation,
+                 i, (unsigned long long) generation);
+    }
+}
+
+//empty if data is consistent, else what is wrong
+static std::string check(const StatusData &data) {
+    uint64_t generation = data.m_commands;
+    if (data.m_jobsStarted != generation * 3 || data.m_jobsFinished != generation * 7) return "counters";
+    if (data.m_jobCount != generation % (STATUS_MAX_JOBS + 1)) return "job count";
+    char expected[STATUS_COMMAND_MAX + 1];
+    for (uint32_t i = 0; i < data.m_jobCount; i++) {
+        const StatusJob &job = data.m_jobs[i];
+        snprintf(expected, sizeof(expected), "job %llu/%u %0120llu", (unsigned long long) generation, i,
+                 (unsigned long long) generation);
+        if (job.m_jobID != (int32_t) i + 1 || job.m_pid != (int32_t) generation ||
+            job.m_startTime != (int64_t) (generation * 1000 + i) || strcmp(job.m_command, expected) != 0) {
+            return "job " + std::to_string(i);
+        }
+    }
+    return "";
+}
+
+static int reader(const std::string &path) {
+    const StatusPageLayout *page = StatusPage::map(path);
+    if (page == nullptr) {
+        fprintf(stderr, "status_stress: reader cannot map %s\n", path.c_str());
+        return 1;
+    }
+    StatusData data;
+    uint64_t snapshots = 0, last = 0, failed = 0;
+    while (last < WRITES) {
+        if (!StatusPage::snapshot(page, data)) {
+            failed++;       //every attempt overlapped a write, fine unless it never succeeds
+            if (failed > 1000000) {
+                fprintf(stderr, "status_stress: reader starved\n");
+                return 1;
+            }
+            continue;
+        }
+        snapshots++;
+        std::string problem = check(data);
+        if (!problem.empty()) {
+            fprintf(stderr, "status_stress: torn snapshot at generation %llu: %s\n",
+                    (unsigned long long) data.m_commands, problem.c_str());
+            return 1;
+        }
+        if (data.m_commands < last) {
+            fprintf(stderr, "status_stress: generation went back from %llu to %llu\n", (unsigned long long) last,
+                    (unsigned long long) data.m_commands);
+            return 1;
+        }
+        last = data.m_commands;
+    }
+    StatusPage::unmap(page);
+    printf("status_stress: %llu consistent snapshots, %llu retried out\n", (unsigned long long) snapshots,
+           (unsigned long long) failed);
+    return 0;
+}
+
+int main() {
+    std::string path = "/dev/shm/smash-stress-" + std::to_string(getpid());
+    StatusPage page;
+    if (!page.create(path)) {
+        path = "/tmp/smash-stress-" + std::to_string(getpid());
+        if (!page.create(path)) {
+            perror("status_stress: create");
+            return 1;
+        }
+    }
+    page.beginWrite();
+    fill(page.data(), 0);
+    page.endWrite();
+
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("status_stress: fork");
+        return 1;
+    }
+    if (pid == 0) _exit(reader(path));
+
+    static StatusData next;
+    for (uint64_t generation = 1; generation <= WRITES; generation++) {
+        //the way smash writes: prepare aside, copy inside the write section
+        fill(next, generation);
+        memcpy(next.m_magic, page.data().m_magic, sizeof(next.m_magic));
+        next.m_size = page.data().m_size;
+        page.beginWrite();
+        memcpy(&page.data(), &next, sizeof(next));
+        page.endWrite();
+    }
+    int status;
+    if (waitpid(pid, &status, 0) == -1) {
+        perror("status_stress: waitpid");
+        return 1;
+    }
+    printf("status_stress: %d writes\n", WRITES);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}